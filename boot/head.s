@@ -225,7 +225,7 @@ idt_descr:				; idt_descr: 是一个符号（label） ，表示这个数据结
 .align 2				; 按 2^2 = 4 字节边界对齐
 .word 0					; 定义一个 16 位的 0 值（填充对齐）
 gdt_descr:
-	.word 256*8-1		; gdt 中最后一个字节的偏移地址。
+	.word 516*8-1		; gdt 中最后一个字节的偏移地址。516 = 4 + 2*NR_TASKS，见 include/linux/head.h 中的 NR_GDT
 	.long _gdt			; GDT 的起始地址
 
 .align 3				; 按 2^3 = 8 字节边界对齐
@@ -236,4 +236,4 @@ _gdt:
 	.quad 0x00c09a0000000fff		/* 16Mb */
 	.quad 0x00c0920000000fff		/* 16Mb */
 	.quad 0x0000000000000000		/* TEMPORARY - don't use */
-	.fill 252,8,0					/* space for LDT's and TSS's etc */
+	.fill 512,8,0					/* space for LDT's and TSS's etc */
@@ -143,7 +143,7 @@ void free_inode(struct m_inode * inode)
     if (!inode)
         return;
     if (!inode->i_dev) {
-        memset(inode,0,sizeof(*inode));
+        clear_inode(inode);
         return;
     }
     if (inode->i_count>1) {
@@ -161,7 +161,7 @@ void free_inode(struct m_inode * inode)
     if (clear_bit(inode->i_num&8191,bh->b_data))
         printk("free_inode: bit already cleared.\n\r");
     bh->b_dirt = 1;
-    memset(inode,0,sizeof(*inode));
+    clear_inode(inode);
 }
 
 /**
@@ -202,6 +202,7 @@ struct m_inode * new_inode(int dev)
     inode->i_gid = current->egid;
     inode->i_dirt = 1;
     inode->i_num = j + i * 8192;
+    insert_inode_hash(inode);               ///< 有了 (dev, nr) 身份，加入 inode 哈希表，iget 才能找到它
     inode->i_mtime = inode->i_atime = inode->i_ctime = CURRENT_TIME;
     return inode;
 }
@@ -36,8 +36,8 @@ int block_write(int dev, long * pos, char * buf, int count)
 		*pos += chars;
 		written += chars;
 		count -= chars;
-		while (chars-->0)
-			*(p++) = get_fs_byte(buf++);
+		memcpy_fromfs(p,buf,chars);
+		buf += chars;
 		bh->b_dirt = 1;
 		brelse(bh);
 	}
@@ -65,8 +65,8 @@ int block_read(int dev, unsigned long * pos, char * buf, int count)
 		*pos += chars;
 		read += chars;
 		count -= chars;
-		while (chars-->0)
-			put_fs_byte(*(p++),buf++);
+		memcpy_tofs(buf,p,chars);
+		buf += chars;
 		brelse(bh);
 	}
 	return read;
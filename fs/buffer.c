@@ -19,20 +19,48 @@
  */
 
 #include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
  
 #include <linux/config.h>
 #include <linux/sched.h>
 #include <linux/kernel.h>
 #include <asm/system.h>
+#include <asm/segment.h>
 #include <asm/io.h>
 
 extern int end;
 struct buffer_head * start_buffer = (struct buffer_head *) &end;        ///< end 为代码段、数据段以及 bss 段的结束，定义在 link.ld 中
 struct buffer_head * hash_table[NR_HASH];
-static struct buffer_head * free_list;
+static struct buffer_head * lru_list[NR_LIST] = {NULL, };  ///< 未被引用的块按状态分成的 LRU 链表，链表头最久未使用
+static int nr_buffers_type[NR_LIST] = {0, };                ///< 各 LRU 链表上的块数
 static struct task_struct * buffer_wait = NULL;
 int NR_BUFFERS = 0;         ///< buffer 块个数
 
+/*
+ * bdflush 后台写回守护进程的可调参数，通过 sys_bdflush(2*n+2, addr) 读取、
+ * sys_bdflush(2*n+3, value) 设置第 n 个参数。
+ */
+#define N_PARAM 4
+#define NR_BDFLUSH_MAX 64       /* 每轮写回块数的上限，收集数组放在内核栈上 */
+
+static union bdflush_param {
+    struct {
+        int nfract;             ///< 脏块占全部缓冲块的百分比超过该值时，不再等待老化，立即写回
+        int ndirty;             ///< 每轮最多提交写回的块数
+        int interval;           ///< 两轮写回之间的间隔（jiffies）
+        int age_buffer;         ///< 脏块的老化时间（jiffies），超过即写回
+    } b_un;
+    int data[N_PARAM];
+} bdf_prm = {{60, 32, 5*HZ, 30*HZ}};
+
+static int bdflush_min[N_PARAM] = {0, 1, 1, 0};
+static int bdflush_max[N_PARAM] = {100, NR_BDFLUSH_MAX, 600*HZ, 600*HZ};
+
+static int bdflush_running = 0;                     ///< 守护进程是否已经启动
+static struct task_struct * bdflush_wait = NULL;    ///< 守护进程空闲时睡眠在这里
+static struct task_struct * bdflush_done = NULL;    ///< 等待守护进程完成一轮写回的进程
+
 /**
  * @brief 等待读取完缓冲区（主要由硬盘初始化后触发 IRQ14 中断来完成）
  */
@@ -128,13 +156,76 @@ void check_disk_change(int dev)     ///< 对 floppy 的检查
             put_super(super_block[i].s_dev);
     invalidate_inodes(dev);
     invalidate_buffers(dev);
+    invalidate_dcache(dev);
+    invalidate_text_pages(dev, 0);
 }
 
 /* 内存 hash 桶 */
 #define _hashfn(dev,block) (((unsigned)(dev^block))%NR_HASH)
 #define hash(dev,block) hash_table[_hashfn(dev,block)]
 
-/* 将内存块移出 hash 表和 free_list */
+/* buffer_head 当前状态对应的 LRU 链表 */
+#define BUF_STATE(bh) ((bh)->b_lock ? BUF_LOCKED : ((bh)->b_dirt ? BUF_DIRTY : BUF_CLEAN))
+
+/* 将内存块移出所在的 LRU 链表，不在链表上则什么都不做 */
+static inline void remove_from_lru(struct buffer_head * bh)
+{
+    if (!bh->b_next_free)
+        return;
+    if (!bh->b_prev_free || bh->b_list >= NR_LIST)
+        panic("Free block list corrupted");
+    nr_buffers_type[bh->b_list]--;
+    if (bh->b_next_free == bh)                      ///< 链表上只剩这一块
+        lru_list[bh->b_list] = NULL;
+    else
+    {
+        bh->b_prev_free->b_next_free = bh->b_next_free;
+        bh->b_next_free->b_prev_free = bh->b_prev_free;
+        if (lru_list[bh->b_list] == bh)
+            lru_list[bh->b_list] = bh->b_next_free;
+    }
+    bh->b_next_free = bh->b_prev_free = NULL;
+}
+
+/* 插入到 LRU 链表 list 的尾部（最近使用） */
+static inline void put_last_lru(struct buffer_head * bh, int list)
+{
+    struct buffer_head * head = lru_list[list];
+
+    bh->b_list = list;
+    nr_buffers_type[list]++;
+    if (!head)
+    {
+        lru_list[list] = bh->b_next_free = bh->b_prev_free = bh;
+        return;
+    }
+    bh->b_next_free = head;
+    bh->b_prev_free = head->b_prev_free;
+    head->b_prev_free->b_next_free = bh;
+    head->b_prev_free = bh;
+}
+
+/**
+ * @brief 按 bh 的当前状态把它重新挂到对应 LRU 链表的尾部。
+ * @details 被引用（b_count != 0）的块只会被移出链表，等 brelse 时再挂回来。
+ * 块第一次进入脏链表时开始老化计时，bdflush 据此决定何时写回。
+ */
+static inline void refile_buffer(struct buffer_head * bh)
+{
+    int list;
+
+    remove_from_lru(bh);
+    if (bh->b_count)
+        return;
+    list = BUF_STATE(bh);
+    if (list == BUF_CLEAN)
+        bh->b_flushtime = 0;
+    else if (list == BUF_DIRTY && !bh->b_flushtime)
+        bh->b_flushtime = jiffies + bdf_prm.b_un.age_buffer;
+    put_last_lru(bh, list);
+}
+
+/* 将内存块移出 hash 表和 LRU 链表 */
 static inline void remove_from_queues(struct buffer_head * bh)
 {
 /* remove from hash-queue */
@@ -144,24 +235,13 @@ static inline void remove_from_queues(struct buffer_head * bh)
         bh->b_prev->b_next = bh->b_next;
     if (hash(bh->b_dev,bh->b_blocknr) == bh)
         hash(bh->b_dev,bh->b_blocknr) = bh->b_next;
-/* remove from free list */
-    if (!(bh->b_prev_free) || !(bh->b_next_free))
-        panic("Free block list corrupted");
-    bh->b_prev_free->b_next_free = bh->b_next_free;
-    bh->b_next_free->b_prev_free = bh->b_prev_free;
-    if (free_list == bh)
-        free_list = bh->b_next_free;
+/* remove from lru list */
+    remove_from_lru(bh);
 }
 
-/* 插入到空闲队列尾部，并放入 hash_table 中 */
+/* 放入 hash_table 中，被引用的块不挂到 LRU 链表上，brelse 时再挂回去 */
 static inline void insert_into_queues(struct buffer_head * bh)
 {
-/* put at end of free list */
-    bh->b_next_free = free_list;
-    bh->b_prev_free = free_list->b_prev_free;
-    free_list->b_prev_free->b_next_free = bh;
-    free_list->b_prev_free = bh;
-
 /* put the buffer in new hash-queue if it has a device */
     bh->b_prev = NULL;
     bh->b_next = NULL;
@@ -171,7 +251,8 @@ static inline void insert_into_queues(struct buffer_head * bh)
     /// 放入到 hash_table 的桶中
     bh->b_next = hash(bh->b_dev,bh->b_blocknr);        
     hash(bh->b_dev,bh->b_blocknr) = bh;
-    bh->b_next->b_prev = bh;
+    if (bh->b_next)
+        bh->b_next->b_prev = bh;
 }
 
 /**
@@ -199,87 +280,159 @@ struct buffer_head * get_hash_table(int dev, int block)
     {
         if (!(bh = find_buffer(dev, block)))
             return NULL;
-        bh->b_count++;    ///< 增加引用计数
+        if (!bh->b_count++)     ///< 增加引用计数，被引用的块不再参与替换，移出 LRU 链表
+            remove_from_lru(bh);
         wait_on_buffer(bh);
         if (bh->b_dev == dev && bh->b_blocknr == block)
             return bh;
-        bh->b_count--;
+        if (!--bh->b_count)
+            refile_buffer(bh);
     }
 }
 
+/**
+ * @brief 从干净链表头部取出最久未使用的可替换块，不会睡眠。
+ * @details 链表归属是惰性维护的：头部的块如果已经变脏或被锁定，就把它转移到对应链表后继续取，
+ * 每个块在一次状态变化后最多被转移一次，所以摊还是 O(1)。
+ * 干净链表空了，再把锁定链表中已经完成 IO 的块转移出来（锁定链表长度受请求队列限制）。
+ */
+static struct buffer_head * get_clean_buffer(void)
+{
+    struct buffer_head * bh, * next, * last;
+
+    while (bh = lru_list[BUF_CLEAN])
+    {
+        if (!bh->b_count && BUF_STATE(bh) == BUF_CLEAN)
+            return bh;
+        refile_buffer(bh);
+    }
+    if (!(bh = lru_list[BUF_LOCKED]))
+        return NULL;
+    last = bh->b_prev_free;
+    for (;;)
+    {
+        next = bh->b_next_free;
+        if (!bh->b_lock)                            ///< IO 已完成，转移到干净或脏链表，不会再回到锁定链表
+            refile_buffer(bh);
+        if (bh == last)
+            break;
+        bh = next;
+    }
+    return lru_list[BUF_CLEAN];
+}
+
+/* 缓冲块处于写回压力下：没有干净块，或者脏块比例超过了 nfract */
+#define BDFLUSH_PRESSURE() (!lru_list[BUF_CLEAN] || \
+    nr_buffers_type[BUF_DIRTY] * 100 > bdf_prm.b_un.nfract * NR_BUFFERS)
+
+/* 写回顺序：先按设备，再按块号 */
+#define BH_AFTER(a,b) ((a)->b_dev > (b)->b_dev || \
+    ((a)->b_dev == (b)->b_dev && (a)->b_blocknr > (b)->b_blocknr))
+
+/**
+ * @brief 从脏链表中挑出需要写回的块，按设备和块号排序后交给 ll_rw_block 异步写回。
+ * @param force 为 0 时只写回已经老化的块，否则从最旧的开始写，不看年龄。
+ * @return 本轮提交写回的块数，最多 bdf_prm.b_un.ndirty 个。
+ */
+static int flush_dirty_buffers(int force)
+{
+    struct buffer_head * list[NR_BDFLUSH_MAX];
+    struct buffer_head * bh, * next;
+    int i, n = 0, nr = nr_buffers_type[BUF_DIRTY];
+
+    /// 收集阶段不会睡眠，链表只会因为当前块被移走而变短
+    for (bh = lru_list[BUF_DIRTY]; nr-- > 0 && n < bdf_prm.b_un.ndirty; bh = next)
+    {
+        if (!lru_list[BUF_DIRTY])
+            break;
+        next = bh->b_next_free;
+        if (!bh->b_dirt || bh->b_lock)          ///< 已经被 sync 写回或正在写，顺便转移到正确的链表
+        {
+            refile_buffer(bh);
+            continue;
+        }
+        if (!force && bh->b_flushtime > jiffies)
+            continue;
+        remove_from_lru(bh);                    ///< 持有引用，防止提交期间被 getblk 替换
+        bh->b_count++;
+        for (i = n++; i > 0 && BH_AFTER(list[i-1], bh); i--)   ///< 按扇区顺序插入排序
+            list[i] = list[i-1];
+        list[i] = bh;
+    }
+    for (i = 0; i < n; i++)
+        if (list[i]->b_dirt)
+            ll_rw_block(WRITE, list[i]);        ///< 可能因请求队列满而睡眠
+    for (i = 0; i < n; i++)
+        if (!--list[i]->b_count)
+            refile_buffer(list[i]);             ///< 写请求已入队的块转移到锁定链表
+    return n;
+}
+
+/**
+ * @brief 没有干净块可用时，让脏块进入写回，然后等待最旧的一个 IO 完成。
+ * @details bdflush 已经启动时交给它去写，自己只等待；否则（如挂载根文件系统期间）在当前进程里异步提交一批。
+ * 无论哪种情况都不会像原来的 sync_dev(bh->b_dev) 那样在调用者上下文里同步写出整个设备。
+ */
+static void writeback_dirty(void)
+{
+    struct buffer_head * bh;
+
+    if (lru_list[BUF_DIRTY])
+    {
+        if (bdflush_running)
+        {
+            wake_up(&bdflush_wait);
+            sleep_on(&bdflush_done);
+        }
+        else
+            flush_dirty_buffers(1);
+    }
+    if (bh = lru_list[BUF_LOCKED])
+        wait_on_buffer(bh);
+    else if (!lru_list[BUF_CLEAN])
+        sleep_on(&buffer_wait);
+}
+
 /**
  * @brief 获取一个空闲链表头，如果当前块在 hash_table 里，则直接返回这个块；
- * 如果不在 hash_table 里，从空闲链表里找到一块，如果这个块被占用，则同步磁盘进行释放。
+ * 如果不在 hash_table 里，从干净 LRU 链表头部取出最久未使用的块，没有干净块则先交给写回再重试。
  * 将这个块插入 hash_table。
  * @note 获取到的 buffer_head->b_data 已经在 buffer_init 中分配了。
  */
-#define BADNESS(bh) (((bh)->b_dirt<<1)+(bh)->b_lock)
 struct buffer_head * getblk(int dev, int block)
 {
-    struct buffer_head * tmp, * bh;
+    struct buffer_head * bh;
 
 repeat:
     /// 如果当前块在 hash_table 里，则直接返回
     if (bh = get_hash_table(dev, block))
         return bh;
 
-    tmp = free_list;                    ///< 可用内存循环链表头
-    do {
-        if (tmp->b_count)               ///< 判断内存块是否被使用，是就继续找下一块
-            continue;
-        if (!bh || BADNESS(tmp) < BADNESS(bh)) ///< !bh为首次进入的情况，BADNESS(tmp) < BADNESS(bh)为找到了更好的 buffer_head
-        {
-            bh = tmp;                   ///< 找到了内存块
-            if (!BADNESS(tmp))          ///< 不是脏的 & 不被锁定
-                break;
-        }
-/* and repeat until we find something good */
-    } while ((tmp = tmp->b_next_free) != free_list);        ///< 循环检查一圈，来寻找空闲内存块
-    
-    /// 找了一圈都没找到，睡一觉重新找
-    if (!bh) 
+    if (!(bh = get_clean_buffer()))
     {
-        sleep_on(&buffer_wait);
-        goto repeat;
+        /// 没有可替换的块：所有块都被引用则睡眠等待 brelse，否则写回脏块或等待 IO 完成。
+        if (!lru_list[BUF_LOCKED] && !lru_list[BUF_DIRTY])
+            sleep_on(&buffer_wait);
+        else
+            writeback_dirty();
+        goto repeat;    ///< 睡眠期间别人可能已经把这个块读进来了，重新查 hash
     }
 
-    /// 走到这里有两种情况。
-    /// 第一种情况：找到了一块干净的 buffer_head，即 b_dirt 和 b_lock 都为 0，这是最理想的情况。
-    /// 第二种情况：找了一圈没有干净的 buffer_head，说明被用空了，这时由上面的 while 循环可知，bh = free_list，
-    ///            即拿到了最久的 buffer_head，因为free_list是尾插法（新用一块就插入 free_list 末尾）
-    ///            这个时候就需要将这个内存同步到对应的磁盘中再拿来用了。
-    wait_on_buffer(bh);      ///< 等待 bh 不被锁定。
-    if (bh->b_count)         ///< 如果还有人在使用这个内存，重新找。
-        goto repeat;
-
-    /// 走到这里，说明找到一块没人用的内存块，如果当前块为脏，则需要写入磁盘
-    while (bh->b_dirt)
-    {
-        sync_dev(bh->b_dev);    ///< 完成磁盘同步之后会解锁 bh。
-        wait_on_buffer(bh);
-        if (bh->b_count)
-            goto repeat;
-    }
-
-/* NOTE!! While we slept waiting for this block, somebody else might */
-/* already have added "this" block to the cache. check it */
-    if (find_buffer(dev, block))
-        goto repeat;
-/* OK, FINALLY we know that this buffer is the only one of it's kind, */
-/* and that it's unused (b_count=0), unlocked (b_lock=0), and clean */
+/* get_clean_buffer() never sleeps, so nobody can have added "this" block */
+/* to the cache meanwhile: bh is unused (b_count=0), unlocked and clean */
     bh->b_count = 1;
     bh->b_dirt = 0;
     bh->b_uptodate=0;                           ///< 并不是磁盘中最新的
-    remove_from_queues(bh);                     ///< 将内存块移出 hash 表和 free_list。
+    remove_from_queues(bh);                     ///< 将内存块移出 hash 表和 LRU 链表。
     bh->b_dev = dev;
     bh->b_blocknr = block;
-    insert_into_queues(bh);                     ///< 放入尾部。
+    insert_into_queues(bh);                     ///< 放入 hash 表，brelse 后再挂到 LRU 链表尾部。
     return bh;
 }
 
 /**
  * @brief 释放缓冲区，唤醒没有缓冲区可用的进程
- * @details 操作只是减少进程的引用个数，实际的释放是在 getblk 调用时进行磁盘同步。
+ * @details 操作只是减少进程的引用个数，引用计数为 0 时按状态挂回 LRU 链表尾部，实际的替换在 getblk 中进行。
  */
 void brelse(struct buffer_head * buf)
 {
@@ -288,6 +441,8 @@ void brelse(struct buffer_head * buf)
     wait_on_buffer(buf);            ///< 等待缓冲区没有被锁定
     if (!(buf->b_count--))          ///< 减少使用标记
         panic("Trying to free free buffer");    ///< 逻辑错误，缓冲区已被释放
+    if (!buf->b_count)
+        refile_buffer(buf);         ///< 没人引用了，成为最近使用的可替换块
     wake_up(&buffer_wait);          ///< 这个队列中是拿不到缓冲区的队列，那我这里既然要释放该缓冲区了，说明这个缓冲区可以给别人用了，所以这里唤醒等获取缓冲区的进程。
 }
 
@@ -321,11 +476,20 @@ __asm__("cld\n\t" \
     ::"c" (BLOCK_SIZE/4),"S" (from),"D" (to) \
     :"cx","di","si")
 
+#define CLEARBLK(to) \
+__asm__("cld\n\t" \
+    "rep\n\t" \
+    "stosl\n\t" \
+    ::"a" (0),"c" (BLOCK_SIZE/4),"D" (to) \
+    :"cx","di")
+
 /*
  * bread_page reads four buffers into memory at the desired address. It's
  * a function of its own, as there is some speed to be got by reading them
  * all at the same time, not waiting for one to be read, and then another
  * etc.
+ *
+ * 空洞（块号为 0）和读取失败的块填 0，所以调用者可以给它一个未清零的页。
  */
 void bread_page(unsigned long address,int dev,int b[4])
 {
@@ -339,13 +503,47 @@ void bread_page(unsigned long address,int dev,int b[4])
                     ll_rw_block(READ,bh[i]);
         } else
             bh[i] = NULL;
-    for (i=0 ; i<4 ; i++,address += BLOCK_SIZE)
+    for (i=0 ; i<4 ; i++,address += BLOCK_SIZE) {
         if (bh[i]) {
             wait_on_buffer(bh[i]);
-            if (bh[i]->b_uptodate)
+            if (bh[i]->b_uptodate) {
                 COPYBLK((unsigned long) bh[i]->b_data,address);
+                brelse(bh[i]);
+                continue;
+            }
             brelse(bh[i]);
         }
+        CLEARBLK(address);
+    }
+}
+
+/**
+ * @brief 对块 block 发起预读（READA），不等待读取完成。
+ * @details 块已经在缓存中就什么都不做；请求队列满时预读请求会被块设备层直接丢弃。
+ */
+void bread_ahead(int dev, int block)
+{
+    struct buffer_head * bh;
+
+    if (!(bh = getblk(dev, block)))
+        return;
+    if (!bh->b_uptodate)
+        ll_rw_block(READA, bh);
+    if (!--bh->b_count)             ///< 不能用 brelse，它会等待读取完成
+        refile_buffer(bh);
+}
+
+/**
+ * @brief 等待已经用 ll_rw_block 发起的读取完成。
+ * @details 给先发起读取、再做别的事（比如预读）、最后才等待的调用者用。读取失败时释放缓冲区，返回 NULL。
+ */
+struct buffer_head * bread_wait(struct buffer_head * bh)
+{
+    wait_on_buffer(bh);
+    if (bh->b_uptodate)
+        return bh;
+    brelse(bh);
+    return NULL;
 }
 
 /*
@@ -356,21 +554,15 @@ void bread_page(unsigned long address,int dev,int b[4])
 struct buffer_head * breada(int dev,int first, ...)
 {
     va_list args;
-    struct buffer_head * bh, *tmp;
+    struct buffer_head * bh;
 
     va_start(args,first);
     if (!(bh=getblk(dev,first)))
         panic("bread: getblk returned NULL\n");
     if (!bh->b_uptodate)
         ll_rw_block(READ,bh);
-    while ((first=va_arg(args,int))>=0) {
-        tmp=getblk(dev,first);
-        if (tmp) {
-            if (!tmp->b_uptodate)
-                ll_rw_block(READA,bh);
-            tmp->b_count--;
-        }
-    }
+    while ((first=va_arg(args,int))>=0)
+        bread_ahead(dev, first);
     va_end(args);
     wait_on_buffer(bh);
     if (bh->b_uptodate)
@@ -380,7 +572,7 @@ struct buffer_head * breada(int dev,int first, ...)
 }
 
 /* 
- * 初始化缓存磁盘的内存（需要将磁盘块读入到内存块中来访问，专门留了部分内存来进行磁盘->内存映射），这部分为 free_list
+ * 初始化缓存磁盘的内存（需要将磁盘块读入到内存块中来访问，专门留了部分内存来进行磁盘->内存映射），全部挂到干净 LRU 链表上
  * 初始化 hash_table，分配出去的 buffer_head 会插入到这个 hash 表中。
  */
 void buffer_init(long buffer_end)                   ///< buffer_end = 4*1024*1024
@@ -399,6 +591,8 @@ void buffer_init(long buffer_end)                   ///< buffer_end = 4*1024*102
         h->b_dirt = 0;
         h->b_count = 0;
         h->b_lock = 0;
+        h->b_list = BUF_CLEAN;
+        h->b_flushtime = 0;
         h->b_uptodate = 0;
         h->b_wait = NULL;
         h->b_next = NULL;
@@ -412,9 +606,71 @@ void buffer_init(long buffer_end)                   ///< buffer_end = 4*1024*102
             b = (void *) 0xA0000;
     }
     h--;                ///< h++ 后还回去
-    free_list = start_buffer;
-    free_list->b_prev_free = h;                     ///< 双向循环链表
-    h->b_next_free = free_list;
+    lru_list[BUF_CLEAN] = start_buffer;
+    nr_buffers_type[BUF_CLEAN] = NR_BUFFERS;
+    start_buffer->b_prev_free = h;                  ///< 双向循环链表
+    h->b_next_free = start_buffer;
     for (i = 0; i < NR_HASH; i++)                   ///< NR_HASH = 307
         hash_table[i] = NULL;                       ///< 初始化 hash_table
-}
\ No newline at end of file
+}
+/**
+ * @brief bdflush 系统调用。
+ * @param func 0：成为后台写回守护进程，正常情况下不返回；
+ *             1：只做一轮老化脏块的写回后返回；
+ *             2*n+2：把第 n 个参数写到用户空间地址 data；
+ *             2*n+3：把第 n 个参数设为 data。
+ * @details 守护进程每隔 interval 个 jiffies 醒来一次，把老化超过 age_buffer 的脏块按扇区顺序写回；
+ * 处于写回压力（没有干净块或脏块比例超过 nfract）时不看年龄，一直写到压力解除。
+ * getblk 找不到干净块时也会唤醒它。收到信号时退出，getblk 回退到自己提交写回。
+ */
+int sys_bdflush(int func, long data)
+{
+    int i, dirty;
+
+    if (!suser())
+        return -EPERM;
+    if (func >= 2)
+    {
+        i = (func - 2) >> 1;
+        if (i >= N_PARAM)
+            return -EINVAL;
+        if (!(func & 1))
+        {
+            verify_area((void *) data, 4);
+            put_fs_long(bdf_prm.data[i], (unsigned long *) data);
+            return 0;
+        }
+        if (data < bdflush_min[i] || data > bdflush_max[i])
+            return -EINVAL;
+        bdf_prm.data[i] = data;
+        return 0;
+    }
+    if (func == 1)
+    {
+        flush_dirty_buffers(0);
+        return 0;
+    }
+    if (func)
+        return -EINVAL;
+    if (bdflush_running)
+        return -EBUSY;
+    bdflush_running = 1;
+    for (;;)
+    {
+        /// 写回压力下一轮接一轮地写，直到某一轮脏块数不再减少（比如设备没有 request_fn，块写不出去）
+        do
+            dirty = nr_buffers_type[BUF_DIRTY];
+        while (BDFLUSH_PRESSURE() && flush_dirty_buffers(1) &&
+            nr_buffers_type[BUF_DIRTY] < dirty);
+        flush_dirty_buffers(0);
+        wake_up(&bdflush_done);             ///< 唤醒等待干净块的 getblk
+
+        /// 睡到下一个周期，或被 getblk 提前唤醒
+        interruptible_sleep_on_timeout(&bdflush_wait, bdf_prm.b_un.interval);
+        if (current->signal & ~current->blocked)
+            break;
+    }
+    bdflush_running = 0;
+    wake_up(&bdflush_done);
+    return -EINTR;
+}
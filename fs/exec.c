@@ -158,7 +158,7 @@ static unsigned long change_ldt(unsigned long text_size,unsigned long * page)
 
 	code_limit = text_size+PAGE_SIZE -1;
 	code_limit &= 0xFFFFF000;
-	data_limit = 0x4000000;
+	data_limit = TASK_SIZE;
 	code_base = get_base(current->ldt[1]);
 	data_base = code_base;
 	set_base(current->ldt[1],code_base);
@@ -315,6 +315,10 @@ restart_interp:
 			goto exec_error2;
 		}
 	}
+	if (vfork_release(0)) {	/* vfork 的子进程不能释放父进程的页表 */
+		retval = -ENOMEM;
+		goto exec_error2;
+	}
 /* OK, This is the point of no return */
 	if (current->executable)
 		iput(current->executable);
@@ -325,8 +329,9 @@ restart_interp:
 		if ((current->close_on_exec>>i)&1)
 			sys_close(i);
 	current->close_on_exec = 0;
-	free_page_tables(get_base(current->ldt[1]),get_limit(0x0f));
-	free_page_tables(get_base(current->ldt[2]),get_limit(0x17));
+	exit_mmap();
+	free_page_tables(current->tss.cr3,get_base(current->ldt[1]),get_limit(0x0f));
+	free_page_tables(current->tss.cr3,get_base(current->ldt[2]),get_limit(0x17));
 	if (last_task_used_math == current)
 		last_task_used_math = NULL;
 	current->used_math = 0;
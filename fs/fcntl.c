@@ -14,6 +14,7 @@
 #include <sys/stat.h>
 
 extern int sys_close(int fd);
+extern int pipe_fcntl(struct m_inode * inode, unsigned int cmd, unsigned long arg);
 
 static int dupfd(unsigned int fd, unsigned int arg)
 {
@@ -67,6 +68,10 @@ int sys_fcntl(unsigned int fd, unsigned int cmd, unsigned long arg)
 			filp->f_flags &= ~(O_APPEND | O_NONBLOCK);
 			filp->f_flags |= arg & (O_APPEND | O_NONBLOCK);
 			return 0;
+		case F_SETPIPE_SZ:	case F_GETPIPE_SZ:
+		case F_SETPIPE_RDWAKE:	case F_SETPIPE_WRWAKE:
+		case F_GETPIPE_STAT:
+			return pipe_fcntl(filp->f_inode,cmd,arg);
 		case F_GETLK:	case F_SETLK:	case F_SETLKW:
 			return -1;
 		default:
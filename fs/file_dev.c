@@ -14,6 +14,41 @@
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
 
+#define MIN_READAHEAD 2		/* 检测到顺序读时的初始预读窗口（块） */
+#define MAX_READAHEAD 32	/* 预读窗口上限，不超过请求队列能容纳的读请求 */
+
+/*
+ * 每个打开的文件各自检测顺序读：读到的块紧接着上一次读的块，预读窗口就翻倍
+ * （最多 MAX_READAHEAD），否则认为发生了 lseek，窗口清零。窗口不为 0 时，对
+ * 当前块之后窗口内、还没预读过的已映射块发起 READA。调用者要先把当前块的读请求
+ * 放进队列再预读，这样当前块排在最前面，不用等在预读后面；相邻的预读块互相合并成
+ * 一条多扇区命令。
+ */
+static void file_readahead(struct m_inode * inode, struct file * filp, long block)
+{
+	long i, end;
+	int nr;
+
+	if (block != filp->f_ralast) {
+		if (block == filp->f_ralast + 1)
+			filp->f_reada = filp->f_reada ?
+				MIN(filp->f_reada << 1, MAX_READAHEAD) : MIN_READAHEAD;
+		else {
+			filp->f_reada = 0;
+			filp->f_raend = block + 1;
+		}
+		filp->f_ralast = block;
+	}
+	if (!filp->f_reada)
+		return;
+	end = MIN(block + filp->f_reada,
+		(long) (inode->i_size + BLOCK_SIZE - 1) / BLOCK_SIZE - 1);
+	for (i = MAX(filp->f_raend, block + 1) ; i <= end ; i++)
+		if (nr = bmap(inode, i))
+			bread_ahead(inode->i_dev, nr);
+	filp->f_raend = MAX(filp->f_raend, i);
+}
+
 int file_read(struct m_inode * inode, struct file * filp, char * buf, int count)
 {
 	int left,chars,nr;
@@ -23,18 +58,22 @@ int file_read(struct m_inode * inode, struct file * filp, char * buf, int count)
 		return 0;
 	while (left) {
 		if (nr = bmap(inode,(filp->f_pos)/BLOCK_SIZE)) {
-			if (!(bh=bread(inode->i_dev,nr)))
-				break;
+			if (!(bh=getblk(inode->i_dev,nr)))
+				panic("file_read: getblk returned NULL");
+			if (!bh->b_uptodate)
+				ll_rw_block(READ,bh);
 		} else
 			bh = NULL;
+		file_readahead(inode, filp, (filp->f_pos)/BLOCK_SIZE);
+		if (bh && !(bh=bread_wait(bh)))
+			break;
 		nr = filp->f_pos % BLOCK_SIZE;
 		chars = MIN( BLOCK_SIZE-nr , left );
 		filp->f_pos += chars;
 		left -= chars;
 		if (bh) {
-			char * p = nr + bh->b_data;
-			while (chars-->0)
-				put_fs_byte(*(p++),buf++);
+			memcpy_tofs(buf,nr + bh->b_data,chars);
+			buf += chars;
 			brelse(bh);
 		} else {
 			while (chars-->0)
@@ -57,6 +96,7 @@ int file_write(struct m_inode * inode, struct file * filp, char * buf, int count
  * ok, append may not work when many processes are writing at the same time
  * but so what. That way leads to madness anyway.
  */
+	invalidate_text_pages(inode->i_dev,inode->i_num);	/* 缓存的代码页要作废 */
 	if (filp->f_flags & O_APPEND)
 		pos = inode->i_size;
 	else
@@ -77,8 +117,8 @@ int file_write(struct m_inode * inode, struct file * filp, char * buf, int count
 			inode->i_dirt = 1;
 		}
 		i += c;
-		while (c-->0)
-			*(p++) = get_fs_byte(buf++);
+		memcpy_fromfs(p,buf,c);
+		buf += c;
 		brelse(bh);
 	}
 	inode->i_mtime = CURRENT_TIME;
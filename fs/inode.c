@@ -6,12 +6,141 @@
 #include <linux/mm.h>
 #include <asm/system.h>
 
-/// 整个系统同时只能有 32 个文件处于“打开”状态（或者说，同时只有 32 个文件的元数据被缓存在内存中）。
-struct m_inode inode_table[NR_INODE]={{0,},};
+/// 内存 inode 表，开机时由 inode_init 按内存大小分配 NR_INODE 项。
+struct m_inode * inode_table;
+int nr_inodes = 0;
+
+/// (dev, nr) 哈希表，iget 不再线性扫描整个 inode_table。
+static struct m_inode * inode_hash_table[NR_IHASH];
+/// 空闲（i_count 为 0）inode 的环形 LRU 链表头。没有身份的 inode 放在表头，释放的缓存 inode 放在表尾，
+/// 所以 get_empty_inode 取表头时总是先用空白的，再淘汰最久没有用过的。
+static struct m_inode * free_inodes = NULL;
+
+#define _ihashfn(dev,nr) (((unsigned)((dev)^(nr)))%NR_IHASH)
+#define ihash(dev,nr) inode_hash_table[_ihashfn(dev,nr)]
+
+/// 清空 inode 时只清到链表指针之前，链表指针由下面的函数维护。
+#define INODE_CLEAR_SIZE ((char *) &((struct m_inode *) 0)->i_hash_next - (char *) 0)
 
 static void read_inode(struct m_inode * inode);
 static void write_inode(struct m_inode * inode);
 
+/**
+ * @brief 开机时分配 inode 表，每 16KB 内存一个 inode，限制在 MIN_INODES～MAX_INODES 之间。
+ * @param mem_start inode 表的起始地址
+ * @param mem_end 内存结尾
+ * @return 占用的内存大小（按页对齐），由调用者从主内存区中扣除。
+ */
+long inode_init(long mem_start, long mem_end)
+{
+    struct m_inode * inode;
+    long size;
+    int i;
+
+    nr_inodes = mem_end >> 14;
+    if (nr_inodes < MIN_INODES)
+        nr_inodes = MIN_INODES;
+    if (nr_inodes > MAX_INODES)
+        nr_inodes = MAX_INODES;
+    inode_table = (struct m_inode *) mem_start;
+    size = (nr_inodes * sizeof(struct m_inode) + 4095) & ~4095;
+    memset(inode_table, 0, size);
+    /// 所有 inode 依次串成空闲环形链表
+    for (i = 0, inode = inode_table; i < NR_INODE; i++, inode++)
+    {
+        inode->i_free_next = inode_table + (i + 1) % NR_INODE;
+        inode->i_free_prev = inode_table + (i + NR_INODE - 1) % NR_INODE;
+    }
+    free_inodes = inode_table;
+    return size;
+}
+
+static inline void remove_from_ihash(struct m_inode * inode)
+{
+    if (inode->i_hash_next)
+        inode->i_hash_next->i_hash_prev = inode->i_hash_prev;
+    if (inode->i_hash_prev)
+        inode->i_hash_prev->i_hash_next = inode->i_hash_next;
+    else if (ihash(inode->i_dev, inode->i_num) == inode)
+        ihash(inode->i_dev, inode->i_num) = inode->i_hash_next;
+    inode->i_hash_next = inode->i_hash_prev = NULL;
+}
+
+/**
+ * @brief inode 有了 (i_dev, i_num) 之后加入哈希表，由 iget 和 new_inode 调用。
+ */
+void insert_inode_hash(struct m_inode * inode)
+{
+    inode->i_hash_prev = NULL;
+    if (inode->i_hash_next = ihash(inode->i_dev, inode->i_num))
+        inode->i_hash_next->i_hash_prev = inode;
+    ihash(inode->i_dev, inode->i_num) = inode;
+}
+
+static inline void remove_from_free(struct m_inode * inode)
+{
+    if (!inode->i_free_next)
+        return;
+    if (free_inodes == inode)
+        free_inodes = inode->i_free_next;
+    if (free_inodes == inode)           ///< 链表上只有它一个
+        free_inodes = NULL;
+    inode->i_free_prev->i_free_next = inode->i_free_next;
+    inode->i_free_next->i_free_prev = inode->i_free_prev;
+    inode->i_free_next = inode->i_free_prev = NULL;
+}
+
+/* 放到空闲链表表尾，最后才会被复用 */
+static inline void put_last_free(struct m_inode * inode)
+{
+    if (!free_inodes)
+    {
+        free_inodes = inode->i_free_next = inode->i_free_prev = inode;
+        return;
+    }
+    inode->i_free_next = free_inodes;
+    inode->i_free_prev = free_inodes->i_free_prev;
+    free_inodes->i_free_prev->i_free_next = inode;
+    free_inodes->i_free_prev = inode;
+}
+
+/* 放到空闲链表表头，最先被复用 */
+static inline void put_first_free(struct m_inode * inode)
+{
+    put_last_free(inode);
+    free_inodes = inode;
+}
+
+/* 清空 inode 的内容并移出哈希表，保留空闲链表指针 */
+static inline void wipe_inode(struct m_inode * inode)
+{
+    remove_from_ihash(inode);
+    memset(inode, 0, INODE_CLEAR_SIZE);
+}
+
+/**
+ * @brief 清空一个不再使用的 inode（i_count 清 0），放到空闲链表表头。由 free_inode 调用。
+ */
+void clear_inode(struct m_inode * inode)
+{
+    remove_from_free(inode);
+    wipe_inode(inode);
+    put_first_free(inode);
+}
+
+/**
+ * @brief 在哈希表中查找 (dev, nr) 对应的内存 inode，不改变引用计数。
+ */
+static struct m_inode * find_inode(int dev, int nr)
+{
+    struct m_inode * inode;
+
+    for (inode = ihash(dev, nr); inode; inode = inode->i_hash_next)
+        if (inode->i_dev == dev && inode->i_num == nr)
+            return inode;
+    return NULL;
+}
+
 /**
  * @brief 等待 inode 解除锁定。
  * @notes 在读写 inode 时会加锁。
@@ -56,7 +185,13 @@ void invalidate_inodes(int dev)
         if (inode->i_dev == dev) {
             if (inode->i_count)
                 printk("inode in use on removed disk\n\r");
+            remove_from_ihash(inode);
             inode->i_dev = inode->i_dirt = 0;
+            if (!inode->i_count)        ///< 已经没有身份了，移到空闲链表表头尽早复用
+            {
+                remove_from_free(inode);
+                put_first_free(inode);
+            }
         }
     }
 }
@@ -205,17 +340,19 @@ void iput(struct m_inode * inode)
         wake_up(&inode->i_wait);
         if (--inode->i_count)       ///< 如果不是最后一个引用，则返回；如果是，则释放页面。
             return;
-        free_page(inode->i_size);   ///< 释放管道所占物理页面。
+        free_pipe_pages(inode);     ///< 释放管道所占物理页面。
         inode->i_count = 0;
         inode->i_dirt = 0;
         inode->i_pipe = 0;
+        put_first_free(inode);
         return;
     }
 
     /// 防御性检查，什么情况下 inode->i_dev==0 ？有可能是块刚被分配，尚未初始化。
     if (!inode->i_dev)
     {
-        inode->i_count--;           ///< 释放引用。
+        if (!--inode->i_count)      ///< 释放引用。
+            put_first_free(inode);
         return;
     }
 
@@ -247,53 +384,43 @@ repeat:
         goto repeat;
     }
     inode->i_count--;           ///< 减少自身引用，即释放 inode，其他进程可以复用这个 inode 了。
+    put_last_free(inode);       ///< 仍然留在哈希表中缓存，放到空闲链表表尾，最后才被淘汰。
     return;
 }
 
 /**
  * @brief 获取空闲 inode
- * @details 从 inode 列表 inode_table 中寻找无人使用的 inode，即寻找 inode->i_count = 0
- * 如果是脏的，就同步到磁盘的内存缓存 buffer_head，并且重置这个 inode，将引用计数 inode->i_count = 1
+ * @details 从空闲链表表头取 i_count = 0 的 inode：表头是没有身份的空白 inode，其后按最近最少使用的顺序排列缓存的 inode。
+ * 尽量挑一个不用等待的（非脏且未锁定）；整条链表都不行时，就等待表头的 inode 解锁并同步到磁盘的内存缓存 buffer_head，然后重新挑选。
+ * 取到后移出哈希表和空闲链表，重置这个 inode，将引用计数 inode->i_count = 1
  */
 struct m_inode * get_empty_inode(void)
 {
     struct m_inode * inode;
-    static struct m_inode * last_inode = inode_table;
     int i;
 
-    do {
-        inode = NULL;
-        /// 从 inode 表中寻找空闲 inode
-        for (i = NR_INODE; i ; i--) 
+repeat:
+    if (!(inode = free_inodes))         ///< 找不到空闲 inode 时打印提示信息
+    {
+        for (i=0 ; i < NR_INODE ; i++)
+            printk("%04x: %6d\t",inode_table[i].i_dev, inode_table[i].i_num);
+        panic("No free inodes in mem");
+    }
+    while (inode->i_dirt || inode->i_lock)
+        if ((inode = inode->i_free_next) == free_inodes)
         {
-            if (++last_inode >= inode_table + NR_INODE)
-                last_inode = inode_table;
-            if (!last_inode->i_count)
+            /// 全部都是脏的或者锁定的，同步表头的 inode。睡眠期间链表可能变化，所以重新挑选。
+            inode = free_inodes;
+            wait_on_inode(inode);       ///< 等待 inode 解锁。
+            while (inode->i_dirt)       ///< 同步 inode。
             {
-                inode = last_inode;
-                if (!inode->i_dirt && !inode->i_lock)
-                    break;
+                write_inode(inode);     ///< 同步到磁盘的内存缓存 buffer_head 中。
+                wait_on_inode(inode);   ///< 等待 inode 解除锁
             }
+            goto repeat;
         }
-        if (!inode)        ///< 找不到空闲 inode 时打印提示信息
-        {
-            for (i=0 ; i < NR_INODE ; i++)
-                printk("%04x: %6d\t",inode_table[i].i_dev, inode_table[i].i_num);
-            panic("No free inodes in mem");
-        }
-        /* 
-        走到这里分两种情况：
-            1.找到空闲的 inode（i_count=0），非脏且非锁定。
-            2.找到空闲的 inode（i_count=0），找到的 inode 可能是 dirty 和 lock 的，这时候就需要同步 inode 到磁盘。
-        */
-        wait_on_inode(inode);    ///< 等待 inode 解锁。
-        while (inode->i_dirt)    ///< 同步 inode。
-        {
-            write_inode(inode);  ///< 同步到磁盘的内存缓存 buffer_head 中。
-            wait_on_inode(inode);///< 等待 inode 解除锁
-        }
-    } while (inode->i_count);
-    memset(inode, 0, sizeof(*inode));
+    remove_from_free(inode);
+    wipe_inode(inode);
     inode->i_count = 1;
     return inode;
 }
@@ -301,13 +428,22 @@ struct m_inode * get_empty_inode(void)
 struct m_inode * get_pipe_inode(void)
 {
     struct m_inode * inode;
+    int i;
 
     if (!(inode = get_empty_inode()))
         return NULL;
-    if (!(inode->i_size=get_free_page())) {
-        inode->i_count = 0;
+    if (!(inode->i_size=(unsigned long) malloc(PIPE_MAX_PAGES*sizeof(long)))) {
+        iput(inode);
         return NULL;
     }
+    for (i = 0 ; i < PIPE_DEF_PAGES ; i++)
+        if (!(PIPE_MAP(*inode)[i]=__get_free_page(0))) {    /* 管道只读出写进去的数据 */
+            PIPE_PAGES(*inode) = i;
+            free_pipe_pages(inode);
+            iput(inode);
+            return NULL;
+        }
+    PIPE_PAGES(*inode) = PIPE_DEF_PAGES;
     inode->i_count = 2;    /* sum of readers/writers */
     PIPE_HEAD(*inode) = PIPE_TAIL(*inode) = 0;
     inode->i_pipe = 1;
@@ -318,35 +454,31 @@ struct m_inode * get_pipe_inode(void)
  * @brief 读取 inode，将 inode[nr] 从分区中的 inode 表中读取出来。
  * @param dev 设备号。
  * @param nr inode号。
- * @details 先从 inode_table 中查看该 inode 是否已经在 inode_table 中了，如果不在，就获取一个空闲的 inode，并将该 inode 从磁盘中读取出来。
+ * @details 先在 (dev, nr) 哈希表中查找该 inode 是否已经在内存中了，如果不在，就获取一个空闲的 inode，并将该 inode 从磁盘中读取出来。
+ * 获取空闲 inode 可能睡眠，醒来后要重新查找一遍，避免同一个 inode 在内存中有两份。
  * 特殊情况，如果存在挂载点如 /mnt 挂载了一个 U 盘，则跳入新文件系统中，读取该文件系统的根目录。
  */
 struct m_inode * iget(int dev, int nr)    ///< dev = 0x306, nr = 1，inode 号 1 固定是根目录。
 {
-    struct m_inode * inode, * empty;
+    struct m_inode * inode, * empty = NULL;
 
     if (!dev)
         panic("iget with dev==0");
-    empty = get_empty_inode();            ///< 获取一个空闲 inode 存入 empty。
-    inode = inode_table;
-    while (inode < NR_INODE + inode_table)
+repeat:
+    if (inode = find_inode(dev, nr))
     {
-        if (inode->i_dev != dev || inode->i_num != nr) 
-        {
-            inode++;
-            continue;
-        }
+        if (!inode->i_count++)   ///< 先增加引用计数，睡眠期间它就不会被 get_empty_inode 复用。
+            remove_from_free(inode);
         wait_on_inode(inode);    ///< 等待 inode 解除锁定，如果锁定则进入睡眠，
                                  ///< 等待 inode 使用者来唤醒自己，这个时候就是当前进程独占这个 inode，其他进程还睡眠在这个 inode 上。
 
-        /// 为什么要再次检查？因为在调用 wait_on_inode 等待它解锁的这段时间里，另一个进程可能已经修改了它。
+        /// 为什么要再次检查？因为在调用 wait_on_inode 等待它解锁的这段时间里，设备可能已经被卸下（invalidate_inodes）。
         /// 这里确保拿到的是这个 inode 无误。
         if (inode->i_dev != dev || inode->i_num != nr)
         {
-            inode = inode_table;
-            continue;
+            iput(inode);
+            goto repeat;
         }
-        inode->i_count++;        ///< 增加引用计数。
 
         /// 这个目录是一个文件系统挂载点，如 /mnt 挂载了一块 U 盘。
         if (inode->i_mount)
@@ -369,22 +501,26 @@ struct m_inode * iget(int dev, int nr)    ///< dev = 0x306, nr = 1，inode 号 1
             /// 更新 dev 和 nr，跳入新文件系统。
             dev = super_block[i].s_dev;
             nr = ROOT_INO;
-            inode = inode_table;
-            continue;
+            goto repeat;
         }
-        
-        /// 已经在 inode_table 中找到了 inode，就需要把之前申请的空闲 inode 释放。
+
+        /// 已经在内存中找到了 inode，就需要把之前申请的空闲 inode 释放。
         if (empty)
             iput(empty);
         return inode;
     }
 
-    /// 走到这里就说明上面根据 dev 和 nr 没有在 inode_table 中找到 inode，就是说缓存中没有这个 inode。
-    if (!empty)                 ///< 既没找到空闲 inode 也没在 inode_table 中找到目标 inode，直接返回 NULL。
-        return (NULL);
+    /// 走到这里就说明缓存中没有这个 inode。先申请一个空闲 inode，它可能睡眠，所以回头再查一遍。
+    if (!empty)
+    {
+        if (!(empty = get_empty_inode()))
+            return (NULL);
+        goto repeat;
+    }
     inode = empty;
     inode->i_dev = dev;
     inode->i_num = nr;
+    insert_inode_hash(inode);   ///< 先加入哈希表，read_inode 会锁定它，其他进程找到后等待读取完成。
     read_inode(inode);          ///< 从磁盘中读取 inode。
     return inode;
 }
@@ -74,6 +74,195 @@ static int match(int len, const char * name, struct dir_entry * de)
     return same;
 }
 
+/**
+ * @brief 目录项缓存（dcache）：(目录所在设备, 目录 inode 号, 文件名) -> inode 号。
+ * @details inode 号为 0 表示“不存在”（negative entry），同样可以省掉一次目录扫描。
+ * 空闲项 d_dev 为 0，不在哈希表中。所有项串成环形 LRU 链表，表头最先被复用。
+ */
+struct dcache_entry
+{
+    unsigned short d_dev;           ///< 目录所在设备，0 表示空闲。
+    unsigned short d_dir;           ///< 目录的 inode 号。
+    unsigned short d_ino;           ///< 文件的 inode 号，0 表示目录中没有这个名字。
+    unsigned char d_len;            ///< 文件名长度。
+    char d_name[NAME_LEN];          ///< 文件名，不以 0 结尾。
+    struct dcache_entry * d_hash_next;
+    struct dcache_entry * d_hash_prev;
+    struct dcache_entry * d_lru_next;
+    struct dcache_entry * d_lru_prev;
+};
+
+static struct dcache_entry dcache[NR_DCACHE];
+static struct dcache_entry * dcache_hash[NR_DHASH];
+static struct dcache_entry * dcache_lru = NULL;
+static unsigned long dcache_gen = 0;    ///< 每次使缓存失效都加一。查找期间如果变了，说明目录可能被修改，结果就不能再记入缓存。
+
+/**
+ * @brief 目录项缓存的哈希值，由设备号、目录 inode 号和文件名计算。
+ */
+static int dcache_hashfn(int dev, int dir, const char * name, int len)
+{
+    unsigned long h = dev ^ (dir << 4);
+
+    while (len--)
+        h = (h << 3) ^ (h >> 28) ^ (unsigned char) *name++;
+    return h % NR_DHASH;
+}
+
+/* 第一次使用时把所有项串成环形 LRU 链表 */
+static void dcache_init(void)
+{
+    int i;
+
+    for (i = 0; i < NR_DCACHE; i++)
+    {
+        dcache[i].d_lru_next = dcache + (i + 1) % NR_DCACHE;
+        dcache[i].d_lru_prev = dcache + (i + NR_DCACHE - 1) % NR_DCACHE;
+    }
+    dcache_lru = dcache;
+}
+
+static void dcache_unhash(struct dcache_entry * d)
+{
+    if (!d->d_dev)
+        return;
+    if (d->d_hash_next)
+        d->d_hash_next->d_hash_prev = d->d_hash_prev;
+    if (d->d_hash_prev)
+        d->d_hash_prev->d_hash_next = d->d_hash_next;
+    else
+        dcache_hash[dcache_hashfn(d->d_dev, d->d_dir, d->d_name, d->d_len)] = d->d_hash_next;
+    d->d_hash_next = d->d_hash_prev = NULL;
+    d->d_dev = 0;
+}
+
+/**
+ * @brief 把 d 移到 LRU 链表表尾（最近使用），first 非 0 时移到表头（最先复用）。
+ */
+static void dcache_touch(struct dcache_entry * d, int first)
+{
+    if (dcache_lru == d)
+        dcache_lru = d->d_lru_next;
+    d->d_lru_prev->d_lru_next = d->d_lru_next;
+    d->d_lru_next->d_lru_prev = d->d_lru_prev;
+    d->d_lru_next = dcache_lru;
+    d->d_lru_prev = dcache_lru->d_lru_prev;
+    dcache_lru->d_lru_prev->d_lru_next = d;
+    dcache_lru->d_lru_prev = d;
+    if (first)
+        dcache_lru = d;
+}
+
+/**
+ * @brief 在缓存中查找目录 dir 下的 name（内核空间），找不到返回 NULL。
+ */
+static struct dcache_entry * dcache_find(struct m_inode * dir, const char * name, int len)
+{
+    struct dcache_entry * d;
+
+    if (!dcache_lru)
+        dcache_init();
+    d = dcache_hash[dcache_hashfn(dir->i_dev, dir->i_num, name, len)];
+    for ( ; d; d = d->d_hash_next)
+        if (d->d_dev == dir->i_dev && d->d_dir == dir->i_num &&
+            d->d_len == len && !strncmp(d->d_name, name, len))
+            return d;
+    return NULL;
+}
+
+/**
+ * @brief 记录目录 dir 下 name（内核空间）对应的 inode 号 ino，复用 LRU 表头的项。
+ */
+static void dcache_add(struct m_inode * dir, const char * name, int len, int ino)
+{
+    struct dcache_entry * d;
+    int h;
+
+    if (d = dcache_find(dir, name, len))
+    {
+        d->d_ino = ino;
+        dcache_touch(d, 0);
+        return;
+    }
+    d = dcache_lru;
+    dcache_unhash(d);
+    d->d_dev = dir->i_dev;
+    d->d_dir = dir->i_num;
+    d->d_ino = ino;
+    d->d_len = len;
+    memcpy(d->d_name, name, len);
+    h = dcache_hashfn(d->d_dev, d->d_dir, name, len);
+    d->d_hash_prev = NULL;
+    if (d->d_hash_next = dcache_hash[h])
+        d->d_hash_next->d_hash_prev = d;
+    dcache_hash[h] = d;
+    dcache_touch(d, 0);
+}
+
+/**
+ * @brief 从用户空间取出文件名，超长时按 find_entry 的规则截断。
+ * @return 文件名长度，0 表示名字为空或者超长（NO_TRUNCATE 时）。
+ */
+static int get_name(char * buf, const char * name, int namelen)
+{
+    int i;
+
+#ifdef NO_TRUNCATE
+    if (namelen > NAME_LEN)
+        return 0;
+#else
+    if (namelen > NAME_LEN)
+        namelen = NAME_LEN;
+#endif
+    for (i = 0; i < namelen; i++)
+        buf[i] = get_fs_byte(name + i);
+    return namelen;
+}
+
+/**
+ * @brief 目录 dir 中的 name（用户空间）被添加或删除了，丢掉它的缓存项。
+ */
+static void dcache_forget(struct m_inode * dir, const char * name, int namelen)
+{
+    char buf[NAME_LEN];
+    struct dcache_entry * d;
+
+    dcache_gen++;
+    if (!(namelen = get_name(buf, name, namelen)))
+        return;
+    if (d = dcache_find(dir, buf, namelen))
+    {
+        dcache_unhash(d);
+        dcache_touch(d, 1);
+    }
+}
+
+/**
+ * @brief 丢掉设备 dev 上的缓存项，dir 不为 0 时只丢掉目录 dir 下的（rmdir 之后 inode 号可能被复用）。
+ */
+static void dcache_purge(int dev, int dir)
+{
+    struct dcache_entry * d;
+
+    dcache_gen++;
+    if (!dcache_lru)
+        return;
+    for (d = dcache; d < dcache + NR_DCACHE; d++)
+        if (d->d_dev == dev && (!dir || d->d_dir == dir))
+        {
+            dcache_unhash(d);
+            dcache_touch(d, 1);
+        }
+}
+
+/**
+ * @brief 设备被卸载或者换盘时，丢掉它的全部目录项缓存。
+ */
+void invalidate_dcache(int dev)
+{
+    dcache_purge(dev, 0);
+}
+
 /**
  * @brief 找到当前目录 dir 下的子目录或文件
  * @param dir 当前目录
@@ -212,6 +401,8 @@ static struct buffer_head * add_entry(struct m_inode * dir, const char * name, i
             for (i = 0; i < NAME_LEN ; i++)
                 de->name[i] = (i < namelen) ? get_fs_byte(name + i) : 0;
             bh->b_dirt = 1;
+            dcache_forget(dir, name, namelen);  ///< 调用者接着就填写 de->inode，中间不会睡眠
+
             *res_dir = de;      ///< 返回的文件夹
             return bh;          ///< 内有该目录项的buffer_head。
         }
@@ -224,6 +415,40 @@ static struct buffer_head * add_entry(struct m_inode * dir, const char * name, i
     return NULL;
 }
 
+/**
+ * @brief 在目录 *dir 中查找 name，返回对应的 inode 号，0 表示不存在。
+ * @details 先查目录项缓存；没有命中再调用 find_entry 扫描目录，结果（包括不存在）记入缓存。
+ * ".." 可能跨越挂载点而切换 *dir，总是交给 find_entry 处理，不进缓存。
+ */
+static int lookup(struct m_inode ** dir, const char * name, int namelen)
+{
+    char buf[NAME_LEN];
+    struct buffer_head * bh;
+    struct dir_entry * de;
+    struct dcache_entry * d;
+    unsigned long gen;
+    int len, inr;
+
+    len = get_name(buf, name, namelen);
+    if (len && !(len == 2 && buf[0] == '.' && buf[1] == '.'))
+    {
+        if (d = dcache_find(*dir, buf, len))
+        {
+            dcache_touch(d, 0);
+            return d->d_ino;
+        }
+    }
+    else
+        len = 0;
+    gen = dcache_gen;
+    bh = find_entry(dir, name, namelen, &de);
+    inr = bh ? de->inode : 0;
+    brelse(bh);
+    if (len && gen == dcache_gen)       ///< 扫描时可能睡眠，期间目录有改动的话结果不可靠，不记入缓存
+        dcache_add(*dir, buf, len, inr);
+    return inr;
+}
+
 /**
  * @brief 获取文件的所属文件夹的 inode。
  * @param pathname 文件名，如/dev/tty0
@@ -235,9 +460,7 @@ static struct m_inode * get_dir(const char * pathname)  ///< pathname = /dev/tty
     char c;
     const char * thisname;
     struct m_inode * inode;
-    struct buffer_head * bh;
     int namelen, inr, idev;
-    struct dir_entry * de;
 
     if (!current->root || !current->root->i_count)      ///< 系统根目录
         panic("No root inode");
@@ -270,14 +493,12 @@ static struct m_inode * get_dir(const char * pathname)  ///< pathname = /dev/tty
             /* nothing */ ;
         if (!c)     ///< 如果到达文件末尾，返回找到的inode（当找到文件名时，如 tty0，由上面的 for 循环可知，c 为遍历的最后一位即 \0，此时inode即为文件夹 dev 的 inode）。
             return inode;
-        if (!(bh = find_entry(&inode, thisname, namelen, &de)))         ///< inode 为 root 或者当前工作目录，thisname = dev/tty0, namelen = 3，此时为寻找 dev 文件夹的 inode
+        if (!(inr = lookup(&inode, thisname, namelen)))                 ///< inode 为 root 或者当前工作目录，thisname = dev/tty0, namelen = 3，此时为寻找 dev 文件夹的 inode 号
         {
             iput(inode);
             return NULL;
         }
-        inr = de->inode;
         idev = inode->i_dev;
-        brelse(bh);
         iput(inode);
         if (!(inode = iget(idev, inr)))                 ///< 递归寻找 inode，这里是获取子目录的 inode。
             return NULL;
@@ -319,21 +540,16 @@ struct m_inode * namei(const char * pathname)
     const char * basename;
     int inr,dev,namelen;
     struct m_inode * dir;
-    struct buffer_head * bh;
-    struct dir_entry * de;
 
     if (!(dir = dir_namei(pathname,&namelen,&basename)))
         return NULL;
     if (!namelen)            /* special case: '/usr/' etc */
         return dir;
-    bh = find_entry(&dir,basename,namelen,&de);
-    if (!bh) {
+    if (!(inr = lookup(&dir,basename,namelen))) {
         iput(dir);
         return NULL;
     }
-    inr = de->inode;
     dev = dir->i_dev;
-    brelse(bh);
     iput(dir);
     dir=iget(dev,inr);
     if (dir) {
@@ -378,10 +594,10 @@ int open_namei(const char * pathname, int flag, int mode, struct m_inode ** res_
     }
 
     /// 1.寻找目标文件的inode。
-    bh = find_entry(&dir, basename, namelen, &de);  ///< 寻找目标文件的 inode。dir 为 tty0 所属文件夹 dev 的 inode, basename = tty0, namelen = 4
+    inr = lookup(&dir, basename, namelen);          ///< 寻找目标文件的 inode 号。dir 为 tty0 所属文件夹 dev 的 inode, basename = tty0, namelen = 4
 
     /// 2.如果找不到该文件的inode，那就创建一个新的inode。这部分是对分区上的 inode 位图进行操作。
-    if (!bh)
+    if (!inr)
     {
         if (!(flag & O_CREAT))      ///< 文件 inode 找不到，又不具备创建/写权限，那就按错误处理
         {
@@ -420,11 +636,9 @@ int open_namei(const char * pathname, int flag, int mode, struct m_inode ** res_
         return 0;
     }
 
-    /// 3.该文件 inode 存在，在 find_entry 函数中找到了目录项，此时 bh 中包含了目标文件的目录项。
+    /// 3.该文件 inode 存在，lookup 找到了目录项中的 inode 号 inr。
     /// 上面是操作 inode 位图，这部分是操作 inode 表。我们就将这个 inode(dev, inr) 从磁盘中读取出来，这部分是读取分区中的 inode 表（表中存储了 inode 详细信息）。
-    inr = de->inode;                    ///< 目标文件的 inode 索引。
     dev = dir->i_dev;                   ///< 获取设备。
-    brelse(bh);
     iput(dir);
     if (flag & O_EXCL)                  ///< 如果具备独占标志，如（CREATE | EXCL）说明用户要求：必须创建新的，不能打开旧的。
         return -EEXIST;
@@ -689,6 +903,8 @@ int sys_rmdir(const char * name)
         printk("empty directory has nlink!=2 (%d)",inode->i_nlinks);
     de->inode = 0;
     bh->b_dirt = 1;
+    dcache_forget(dir,basename,namelen);
+    dcache_purge(inode->i_dev,inode->i_num);
     brelse(bh);
     inode->i_nlinks=0;
     inode->i_dirt=1;
@@ -749,6 +965,7 @@ int sys_unlink(const char * name)
     }
     de->inode = 0;
     bh->b_dirt = 1;
+    dcache_forget(dir,basename,namelen);
     brelse(bh);
     inode->i_nlinks--;
     inode->i_dirt = 1;
@@ -195,6 +195,9 @@ int sys_open(const char * filename, int flag, int mode)     ///< filename = /dev
     f->f_count = 1;
     f->f_inode = inode;
     f->f_pos = 0;
+    f->f_reada = 0;
+    f->f_ralast = -1;               ///< 从头读第 0 块也算顺序读
+    f->f_raend = 0;
     return (fd);
 }
 
@@ -5,23 +5,64 @@
  */
 
 #include <signal.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 #include <linux/sched.h>
+#include <linux/kernel.h>
 #include <linux/mm.h>	/* for get_free_page */
 #include <asm/segment.h>
 
+#define MIN(a,b) (((a)<(b))?(a):(b))
+
+static long pipe_wakeups = 0, pipe_sleeps = 0;
+
+/*
+ * 唤醒水位：写者只在空闲空间达到 wr_wake 时才被读者唤醒（默认半个管道），读者只在
+ * 数据达到 rd_wake 时才被写者唤醒（默认 1，即有数据就唤醒）。一方因为管道空/满
+ * 而要睡眠时，总是无条件唤醒另一方，所以不会两边都睡着。关闭一端时 iput 也会唤醒。
+ */
+static inline int rd_wake(struct m_inode * inode)
+{
+	return PIPE_RD_WAKE(*inode) ?
+		MIN(PIPE_RD_WAKE(*inode), PIPE_BUFSIZE(*inode)-1) : 1;
+}
+
+static inline int wr_wake(struct m_inode * inode)
+{
+	return PIPE_WR_WAKE(*inode) ?
+		MIN(PIPE_WR_WAKE(*inode), PIPE_BUFSIZE(*inode)-1) :
+		PIPE_BUFSIZE(*inode)/2;
+}
+
+static inline void pipe_wake(struct m_inode * inode)
+{
+	if (inode->i_wait) {
+		pipe_wakeups++;
+		wake_up(&inode->i_wait);
+	}
+}
+
+static inline void pipe_sleep(struct m_inode * inode)
+{
+	pipe_sleeps++;
+	sleep_on(&inode->i_wait);
+}
+
 int read_pipe(struct m_inode * inode, char * buf, int count)
 {
 	int chars, size, read = 0;
 
 	while (count>0) {
 		while (!(size=PIPE_SIZE(*inode))) {
-			wake_up(&inode->i_wait);
+			pipe_wake(inode);
 			if (inode->i_count != 2) /* are there any writers? */
 				return read;
-			sleep_on(&inode->i_wait);
+			pipe_sleep(inode);
 		}
-		chars = PAGE_SIZE-PIPE_TAIL(*inode);
+		chars = PIPE_PAGE_LEFT(PIPE_TAIL(*inode));
 		if (chars > count)
 			chars = count;
 		if (chars > size)
@@ -30,28 +71,56 @@ int read_pipe(struct m_inode * inode, char * buf, int count)
 		read += chars;
 		size = PIPE_TAIL(*inode);
 		PIPE_TAIL(*inode) += chars;
-		PIPE_TAIL(*inode) &= (PAGE_SIZE-1);
-		while (chars-->0)
-			put_fs_byte(((char *)inode->i_size)[size++],buf++);
+		PIPE_TAIL(*inode) &= (PIPE_BUFSIZE(*inode)-1);
+		memcpy_tofs(buf,PIPE_PTR(*inode,size),chars);
+		buf += chars;
 	}
-	wake_up(&inode->i_wait);
+	if (PIPE_FREE(*inode) >= wr_wake(inode))
+		pipe_wake(inode);
 	return read;
 }
 	
+/*
+ * 先把用户缓冲区涉及的页都读一遍，缺页（可能睡眠）在这里处理完。没有换出，
+ * 页一旦在就一直在，之后的 memcpy_fromfs 不会再睡眠。
+ */
+static void prefault_user(char * buf, int count)
+{
+	char * end = buf + count;
+
+	if (count <= 0)
+		return;
+	get_fs_byte(end-1);
+	for ( ; buf < end ; buf += PAGE_SIZE - ((unsigned long) buf & (PAGE_SIZE-1)))
+		get_fs_byte(buf);
+}
+
+/*
+ * 不超过 PIPE_BUF 字节的写要么整个写进去，要么一点不写：等到管道里的空闲空间放得下
+ * 整个写才开始拷贝（管道容量至少 PIPE_BUF+1 个字节，总能放下）。跨页时分两段拷贝，
+ * 用户缓冲区预先缺页进来，两段之间不会睡眠，别的写者插不进来。
+ */
 int write_pipe(struct m_inode * inode, char * buf, int count)
 {
-	int chars, size, written = 0;
+	int chars, size, need, written = 0;
 
+	if (count <= PIPE_BUF) {
+		need = count;
+		prefault_user(buf,count);
+	} else
+		need = 1;
 	while (count>0) {
-		while (!(size=(PAGE_SIZE-1)-PIPE_SIZE(*inode))) {
-			wake_up(&inode->i_wait);
+		if (need > PIPE_BUFSIZE(*inode)-1)
+			need = PIPE_BUFSIZE(*inode)-1;
+		while ((size=PIPE_FREE(*inode)) < need) {
+			pipe_wake(inode);
 			if (inode->i_count != 2) { /* no readers */
 				current->signal |= (1<<(SIGPIPE-1));
 				return written?written:-1;
 			}
-			sleep_on(&inode->i_wait);
+			pipe_sleep(inode);
 		}
-		chars = PAGE_SIZE-PIPE_HEAD(*inode);
+		chars = PIPE_PAGE_LEFT(PIPE_HEAD(*inode));
 		if (chars > count)
 			chars = count;
 		if (chars > size)
@@ -60,14 +129,239 @@ int write_pipe(struct m_inode * inode, char * buf, int count)
 		written += chars;
 		size = PIPE_HEAD(*inode);
 		PIPE_HEAD(*inode) += chars;
-		PIPE_HEAD(*inode) &= (PAGE_SIZE-1);
-		while (chars-->0)
-			((char *)inode->i_size)[size++]=get_fs_byte(buf++);
+		PIPE_HEAD(*inode) &= (PIPE_BUFSIZE(*inode)-1);
+		need = 1;	/* 原子写剩下的部分（跨页的后半段）已经确认有空间，拷贝也不会睡眠 */
+		memcpy_fromfs(PIPE_PTR(*inode,size),buf,chars);
+		buf += chars;
 	}
-	wake_up(&inode->i_wait);
+	if (PIPE_SIZE(*inode) >= rd_wake(inode))
+		pipe_wake(inode);
 	return written;
 }
 
+void free_pipe_pages(struct m_inode * inode)
+{
+	int i;
+
+	if (!PIPE_MAP(*inode))
+		return;
+	for (i = 0 ; i < PIPE_PAGES(*inode) ; i++)
+		free_page(PIPE_MAP(*inode)[i]);
+	free_s((void *) PIPE_MAP(*inode),PIPE_MAX_PAGES*sizeof(long));
+	inode->i_size = 0;
+	PIPE_PAGES(*inode) = 0;
+}
+
+/*
+ * 把管道容量改成至少 size 字节（向上取到 2 的幂个页），最少 PIPE_BUF/PAGE_SIZE+1 页，
+ * 这样环里总能放下一次 PIPE_BUF 字节的原子写。放不下管道里现有的数据时
+ * 返回 -EBUSY。换一组新页，把现有数据按顺序拷到新环的开头。分配页和 memcpy
+ * 都不会睡眠，中间不会有人读写这个管道。返回新的容量。
+ */
+static int pipe_resize(struct m_inode * inode, int size)
+{
+	unsigned long map[PIPE_MAX_PAGES];
+	int pages, used, i, chars;
+
+	if (size <= 0 || size > PIPE_MAX_PAGES*PAGE_SIZE)
+		return -EINVAL;
+	for (pages = PIPE_BUF/PAGE_SIZE+1 ; pages*PAGE_SIZE < size ; pages <<= 1)
+		/* nothing */ ;
+	if (pages == PIPE_PAGES(*inode))
+		return pages*PAGE_SIZE;
+	if ((used = PIPE_SIZE(*inode)) > pages*PAGE_SIZE-1)
+		return -EBUSY;
+	for (i = 0 ; i < pages ; i++)
+		if (!(map[i] = __get_free_page(0))) {
+			while (i--)
+				free_page(map[i]);
+			return -ENOMEM;
+		}
+	for (i = 0 ; i < used ; i += chars) {
+		chars = MIN(used-i, PIPE_PAGE_LEFT(PIPE_TAIL(*inode)));
+		chars = MIN(chars, PIPE_PAGE_LEFT(i));
+		memcpy((char *) map[i/PAGE_SIZE] + (i&(PAGE_SIZE-1)),
+			PIPE_PTR(*inode,PIPE_TAIL(*inode)),chars);
+		PIPE_TAIL(*inode) += chars;
+		PIPE_TAIL(*inode) &= (PIPE_BUFSIZE(*inode)-1);
+	}
+	for (i = 0 ; i < PIPE_PAGES(*inode) ; i++)
+		free_page(PIPE_MAP(*inode)[i]);
+	for (i = 0 ; i < pages ; i++)
+		PIPE_MAP(*inode)[i] = map[i];
+	PIPE_PAGES(*inode) = pages;
+	PIPE_TAIL(*inode) = 0;
+	PIPE_HEAD(*inode) = used;
+	pipe_wake(inode);
+	return pages*PAGE_SIZE;
+}
+
+/* 管道相关的 fcntl 命令，fd 不是管道时返回 -EBADF */
+int pipe_fcntl(struct m_inode * inode, unsigned int cmd, unsigned long arg)
+{
+	struct pipe_stat * st = (struct pipe_stat *) arg;
+
+	if (!inode || !inode->i_pipe)
+		return -EBADF;
+	switch (cmd) {
+		case F_SETPIPE_SZ:
+			return pipe_resize(inode,arg);
+		case F_GETPIPE_SZ:
+			return PIPE_BUFSIZE(*inode);
+		case F_SETPIPE_RDWAKE:		/* 0 恢复默认值 */
+			if (arg > PIPE_MAX_PAGES*PAGE_SIZE)
+				return -EINVAL;
+			PIPE_RD_WAKE(*inode) = arg;
+			return 0;
+		case F_SETPIPE_WRWAKE:
+			if (arg > PIPE_MAX_PAGES*PAGE_SIZE)
+				return -EINVAL;
+			PIPE_WR_WAKE(*inode) = arg;
+			return 0;
+		case F_GETPIPE_STAT:
+			verify_area(st,sizeof(*st));
+			put_fs_long(pipe_wakeups,&st->ps_wakeups);
+			put_fs_long(pipe_sleeps,&st->ps_sleeps);
+			put_fs_long(nr_switches,&st->ps_switches);
+			return 0;
+	}
+	return -EINVAL;
+}
+
+/*
+ * splice 的两个方向：数据在缓冲块和管道页之间直接用 memcpy 搬，不经过用户空间。
+ * bread/create_block 都可能睡眠，醒来后管道里的数据量可能变了，所以拿到缓冲块之后
+ * 重新计算一次管道的空间/数据量。
+ */
+static int splice_to_pipe(struct file * in, struct m_inode * pipe, int len)
+{
+	struct m_inode * inode = in->f_inode;
+	struct buffer_head * bh;
+	int chars, size, nr, done = 0;
+
+	if (in->f_pos >= inode->i_size)		/* i_size 是无符号数，先判断再相减 */
+		return 0;
+	if (len > (long) (inode->i_size - in->f_pos))
+		len = inode->i_size - in->f_pos;
+	while (len > 0) {
+		if (!(size=PIPE_FREE(*pipe))) {
+			pipe_wake(pipe);
+			if (pipe->i_count != 2) { /* no readers */
+				current->signal |= (1<<(SIGPIPE-1));
+				return done?done:-EPIPE;
+			}
+			pipe_sleep(pipe);
+			continue;
+		}
+		if (nr = bmap(inode,in->f_pos/BLOCK_SIZE)) {
+			if (!(bh=bread(inode->i_dev,nr)))
+				break;
+		} else
+			bh = NULL;		/* 文件空洞读出来是 0 */
+		if (!(size=PIPE_FREE(*pipe))) {
+			brelse(bh);
+			continue;
+		}
+		nr = in->f_pos % BLOCK_SIZE;
+		chars = MIN(BLOCK_SIZE-nr, len);
+		chars = MIN(chars, size);
+		chars = MIN(chars, PIPE_PAGE_LEFT(PIPE_HEAD(*pipe)));
+		if (bh)
+			memcpy(PIPE_PTR(*pipe,PIPE_HEAD(*pipe)),bh->b_data+nr,chars);
+		else
+			memset(PIPE_PTR(*pipe,PIPE_HEAD(*pipe)),0,chars);
+		PIPE_HEAD(*pipe) += chars;
+		PIPE_HEAD(*pipe) &= (PIPE_BUFSIZE(*pipe)-1);
+		in->f_pos += chars;
+		len -= chars;
+		done += chars;
+		brelse(bh);
+	}
+	if (PIPE_SIZE(*pipe) >= rd_wake(pipe))
+		pipe_wake(pipe);
+	inode->i_atime = CURRENT_TIME;
+	return done;
+}
+
+static int splice_from_pipe(struct m_inode * pipe, struct file * out, int len)
+{
+	struct m_inode * inode = out->f_inode;
+	struct buffer_head * bh;
+	int chars, size, block, done = 0;
+	off_t pos;
+
+	invalidate_text_pages(inode->i_dev,inode->i_num);
+	if (out->f_flags & O_APPEND)
+		pos = inode->i_size;
+	else
+		pos = out->f_pos;
+	while (len > 0) {
+		if (!(size=PIPE_SIZE(*pipe))) {
+			pipe_wake(pipe);
+			if (done || pipe->i_count != 2) /* 已经搬了一些，或者没有写者了 */
+				break;
+			pipe_sleep(pipe);
+			continue;
+		}
+		if (!(block = create_block(inode,pos/BLOCK_SIZE)))
+			break;
+		if (!(bh=bread(inode->i_dev,block)))
+			break;
+		if (!(size=PIPE_SIZE(*pipe))) {
+			brelse(bh);
+			continue;
+		}
+		block = pos % BLOCK_SIZE;
+		chars = MIN(BLOCK_SIZE-block, len);
+		chars = MIN(chars, size);
+		chars = MIN(chars, PIPE_PAGE_LEFT(PIPE_TAIL(*pipe)));
+		memcpy(bh->b_data+block,PIPE_PTR(*pipe,PIPE_TAIL(*pipe)),chars);
+		bh->b_dirt = 1;
+		PIPE_TAIL(*pipe) += chars;
+		PIPE_TAIL(*pipe) &= (PIPE_BUFSIZE(*pipe)-1);
+		pos += chars;
+		if (pos > inode->i_size) {
+			inode->i_size = pos;
+			inode->i_dirt = 1;
+		}
+		len -= chars;
+		done += chars;
+		brelse(bh);
+	}
+	if (PIPE_FREE(*pipe) >= wr_wake(pipe))
+		pipe_wake(pipe);
+	inode->i_mtime = CURRENT_TIME;
+	if (!(out->f_flags & O_APPEND)) {
+		out->f_pos = pos;
+		inode->i_ctime = CURRENT_TIME;
+	}
+	return done;
+}
+
+/*
+ * 在普通文件和管道之间搬最多 len 字节，两端必须正好一个是管道。
+ * 返回搬动的字节数，文件读到尾或管道没有写者时返回 0。
+ */
+int sys_splice(unsigned int fd_in, unsigned int fd_out, int len)
+{
+	struct file * in, * out;
+
+	if (fd_in >= NR_OPEN || !(in=current->filp[fd_in]) ||
+	    fd_out >= NR_OPEN || !(out=current->filp[fd_out]))
+		return -EBADF;
+	if (!(in->f_mode & 1) || !(out->f_mode & 2))
+		return -EBADF;
+	if (len < 0)
+		return -EINVAL;
+	if (!len)
+		return 0;
+	if (out->f_inode->i_pipe && S_ISREG(in->f_inode->i_mode))
+		return splice_to_pipe(in,out->f_inode,len);
+	if (in->f_inode->i_pipe && S_ISREG(out->f_inode->i_mode))
+		return splice_from_pipe(in->f_inode,out,len);
+	return -EINVAL;
+}
+
 int sys_pipe(unsigned long * fildes)
 {
 	struct m_inode * inode;
@@ -223,6 +223,8 @@ int sys_umount(char * dev_name)
 	sb->s_isup = NULL;
 	put_super(dev);
 	sync_dev(dev);
+	invalidate_dcache(dev);
+	invalidate_text_pages(dev,0);
 	return 0;
 }
 
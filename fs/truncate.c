@@ -57,6 +57,7 @@ void truncate(struct m_inode * inode)
 
     if (!(S_ISREG(inode->i_mode) || S_ISDIR(inode->i_mode)))    ///< 如果不是普通文件也不是目录，直接返回。
         return;
+    invalidate_text_pages(inode->i_dev, inode->i_num);          ///< 丢掉缓存的代码页，inode 号以后可能被复用。
 
     /// 如果是普通文件或目录
     for (i = 0; i < 7; i++)     ///< 前 7 个为直接数据块
@@ -8,6 +8,17 @@ __asm__ volatile ("inb %%dx,%%al":"=a" (_v):"d" (port)); \
 _v; \
 })
 
+/* 向端口 port 输出 4 字节 value。*/
+#define outl(value,port) \
+__asm__ ("outl %%eax,%%dx"::"a" (value),"d" (port))
+
+/* 从 port 端口读取 4 字节，返回读取到的值。*/
+#define inl(port) ({ \
+unsigned long _v; \
+__asm__ volatile ("inl %%dx,%%eax":"=a" (_v):"d" (port)); \
+_v; \
+})
+
 /* 向端口 port 输出 value 数据。*/
 #define outb_p(value, port) \
 __asm__ ("outb %%al,%%dx\n" \
@@ -40,6 +40,53 @@ extern inline void put_fs_long(unsigned long val,unsigned long * addr)
 __asm__ ("movl %0,%%fs:%1"::"r" (val),"m" (*addr));
 }
 
+/*
+ * 成块复制：先用 movsb 把目的地址补齐到 4 字节边界，中间用 rep movsl，最后不足 4 字节的尾部用 movsb。
+ * 不检查用户空间，写用户空间之前调用者要对整个范围做一次 verify_area（sys_read 中已经做了）。
+ */
+
+/* 从内核 from 复制 n 字节到用户空间 to（fs 段） */
+extern inline void memcpy_tofs(void * to, const void * from, unsigned long n)
+{
+	unsigned long head = (-(unsigned long) to) & 3;
+
+	if (head > n)
+		head = n;
+__asm__("cld\n\t"
+	"push %%es\n\t"
+	"push %%fs\n\t"
+	"pop %%es\n\t"
+	"rep ; movsb\n\t"
+	"movl %%edx,%%ecx\n\t"
+	"shrl $2,%%ecx\n\t"
+	"rep ; movsl\n\t"
+	"movl %%edx,%%ecx\n\t"
+	"andl $3,%%ecx\n\t"
+	"rep ; movsb\n\t"
+	"pop %%es"
+	::"c" (head),"d" (n - head),"D" ((long) to),"S" ((long) from)
+	:"cx","di","si");
+}
+
+/* 从用户空间 from（fs 段）复制 n 字节到内核 to */
+extern inline void memcpy_fromfs(void * to, const void * from, unsigned long n)
+{
+	unsigned long head = (-(unsigned long) to) & 3;
+
+	if (head > n)
+		head = n;
+__asm__("cld\n\t"
+	"fs ; rep ; movsb\n\t"
+	"movl %%edx,%%ecx\n\t"
+	"shrl $2,%%ecx\n\t"
+	"fs ; rep ; movsl\n\t"
+	"movl %%edx,%%ecx\n\t"
+	"andl $3,%%ecx\n\t"
+	"fs ; rep ; movsb"
+	::"c" (head),"d" (n - head),"D" ((long) to),"S" ((long) from)
+	:"cx","di","si");
+}
+
 /*
  * Someone who knows GNU asm better than I should double check the followig.
  * It seems to work, but I don't know if I'm doing something subtly wrong.
@@ -16,6 +16,9 @@ __asm__ ("movl %%esp,%%eax\n\t" \
 #define sti() __asm__ ("sti"::)         /* 开中断 */
 #define cli() __asm__ ("cli"::)         /* 关中断 */
 #define nop() __asm__ ("nop"::)
+/* 保存/恢复 eflags（含中断标志），用于可能在关中断状态下被调用的代码 */
+#define save_flags(x) __asm__ __volatile__("pushfl ; popl %0":"=r" (x))
+#define restore_flags(x) __asm__ __volatile__("pushl %0 ; popfl"::"r" (x))
 
 #define iret() __asm__ ("iret"::)
 /* 构造中断描述符 */
@@ -28,6 +28,11 @@
 #define F_GETLK		5	/* not implemented */
 #define F_SETLK		6
 #define F_SETLKW	7
+#define F_SETPIPE_SZ	1031	/* set pipe capacity (bytes) */
+#define F_GETPIPE_SZ	1032
+#define F_SETPIPE_RDWAKE 1033	/* wake readers at this many queued bytes */
+#define F_SETPIPE_WRWAKE 1034	/* wake writers at this many free bytes */
+#define F_GETPIPE_STAT	1035	/* copy struct pipe_stat to arg */
 
 /* for F_[GET|SET]FL */
 #define FD_CLOEXEC	1	/* actually anything with low bit set goes */
@@ -48,6 +53,13 @@ struct flock {
 	pid_t l_pid;
 };
 
+/* F_GETPIPE_STAT: system-wide counters since boot */
+struct pipe_stat {
+	unsigned long ps_wakeups;	/* wake_up calls on pipes that had sleepers */
+	unsigned long ps_sleeps;	/* times a reader/writer blocked on a pipe */
+	unsigned long ps_switches;	/* context switches (all tasks) */
+};
+
 extern int creat(const char * filename,mode_t mode);
 extern int fcntl(int fildes,int cmd, ...);
 extern int open(const char * filename, int flags, ...);
@@ -18,6 +18,15 @@
 /*#define KBD_FR */
 #define KBD_FINNISH
 
+/*
+ * define the I/O scheduler the block devices start with at boot -
+ * IOSCHED_CLOOK for a one-way (C-LOOK) elevator sorted on device/sector
+ * IOSCHED_DEADLINE for the same elevator, plus read/write expiry times
+ *	so that no request waits much longer than its deadline
+ */
+/*#define IOSCHED_CLOOK */
+#define IOSCHED_DEADLINE
+
 /*
  * Normally, Linux can get the drive parameters from the BIOS at
  * startup, but if this for some unfathomable reason fails, you'd
@@ -41,7 +41,12 @@ void buffer_init(long buffer_end);
 #define SUPER_MAGIC 0x137F
 
 #define NR_OPEN 20
-#define NR_INODE 32         /* 内存中 inode 只有32个，文件系统中远远超过这个数字 */
+#define NR_INODE nr_inodes  /* 内存 inode 个数，开机时按内存大小在 MIN_INODES～MAX_INODES 之间确定 */
+#define MIN_INODES 128
+#define MAX_INODES 1024
+#define NR_IHASH 131        /* inode 哈希表的项数 */
+#define NR_DCACHE 128       /* 目录项缓存（dcache）的项数 */
+#define NR_DHASH 61         /* 目录项缓存哈希表的项数 */
 #define NR_FILE 64
 #define NR_SUPER 8          /* 可以容纳 8 个已挂载文件系统的超级块 */
 #define NR_HASH 307
@@ -55,14 +60,42 @@ void buffer_init(long buffer_end);
 #define INODES_PER_BLOCK ((BLOCK_SIZE)/(sizeof (struct d_inode)))
 #define DIR_ENTRIES_PER_BLOCK ((BLOCK_SIZE)/(sizeof (struct dir_entry)))
 
+/*
+ * 管道缓冲区是 PIPE_PAGES 个不连续的物理页组成的环，页数是 2 的幂，i_size 指向
+ * 存放这些页地址的数组。PIPE_HEAD/PIPE_TAIL 是环内偏移（i_zone 是 16 位，所以环
+ * 最大 32KB）。和原来一样空出一个字节区分空和满。
+ */
+#define PIPE_DEF_PAGES 2	/* 新建管道的默认页数 */
+#define PIPE_MAX_PAGES 8
+#define PIPE_BUF 4096		/* 不超过这么多字节的写是原子的 */
+
 #define PIPE_HEAD(inode) ((inode).i_zone[0])
 #define PIPE_TAIL(inode) ((inode).i_zone[1])
-#define PIPE_SIZE(inode) ((PIPE_HEAD(inode)-PIPE_TAIL(inode))&(PAGE_SIZE-1))
+#define PIPE_PAGES(inode) ((inode).i_zone[2])
+#define PIPE_RD_WAKE(inode) ((inode).i_zone[3])	/* 0 表示默认值，见 pipe.c */
+#define PIPE_WR_WAKE(inode) ((inode).i_zone[4])
+#define PIPE_MAP(inode) ((unsigned long *) (inode).i_size)
+#define PIPE_BUFSIZE(inode) (PIPE_PAGES(inode)*PAGE_SIZE)
+#define PIPE_SIZE(inode) ((PIPE_HEAD(inode)-PIPE_TAIL(inode))&(PIPE_BUFSIZE(inode)-1))
+#define PIPE_FREE(inode) (PIPE_BUFSIZE(inode)-1-PIPE_SIZE(inode))
 #define PIPE_EMPTY(inode) (PIPE_HEAD(inode)==PIPE_TAIL(inode))
-#define PIPE_FULL(inode) (PIPE_SIZE(inode)==(PAGE_SIZE-1))
+#define PIPE_FULL(inode) (!PIPE_FREE(inode))
+/* 环内偏移 off 处的内核地址，以及从 off 到所在页末尾的字节数 */
+#define PIPE_PTR(inode,off) ((char *) PIPE_MAP(inode)[(off)/PAGE_SIZE] + ((off)&(PAGE_SIZE-1)))
+#define PIPE_PAGE_LEFT(off) (PAGE_SIZE-((off)&(PAGE_SIZE-1)))
 #define INC_PIPE(head) \
 __asm__("incl %0\n\tandl $4095,%0"::"m" (head))
 
+/*
+ * 未被引用（b_count == 0）的 buffer_head 按状态挂在三条 LRU 链表上，
+ * 链表头为最久未使用的块。状态由调用者和中断直接修改，链表归属在 getblk
+ * 取块时才惰性地纠正，因此中断里永远不需要操作链表。
+ */
+#define BUF_CLEAN 0     /* 干净且未锁定，可以直接替换 */
+#define BUF_LOCKED 1    /* 正在进行 IO */
+#define BUF_DIRTY 2     /* 脏块，替换前需要先写回 */
+#define NR_LIST 3
+
 typedef char buffer_block[BLOCK_SIZE];
 
 /**
@@ -77,11 +110,14 @@ struct buffer_head
     unsigned char b_dirt;           /* 是否为脏的标记，脏表示需要同步到磁盘。0-非脏，1-脏。 */
     unsigned char b_count;          /* 使用当前缓冲区的进程个数。*/
     unsigned char b_lock;           /* 0 - ok, 1 -locked */
+    unsigned char b_list;           /* 所在的 LRU 链表（BUF_CLEAN/BUF_LOCKED/BUF_DIRTY），b_next_free 为空时无效 */
     struct task_struct * b_wait;    /* 等待在此内存块的进程 */
+    unsigned long b_flushtime;      /* 脏块应当被 bdflush 写回的时刻（jiffies），0 表示未开始老化 */
     struct buffer_head * b_prev;
     struct buffer_head * b_next;
-    struct buffer_head * b_prev_free;
+    struct buffer_head * b_prev_free;   /* LRU 双向循环链表，被引用的块不在任何链表上（指针为 NULL） */
     struct buffer_head * b_next_free;
+    struct buffer_head * b_reqnext;     /* 合并到同一个磁盘请求中的下一个缓冲块 */
 };
 
 /**
@@ -132,6 +168,11 @@ struct m_inode
     unsigned char i_mount;          ///< 挂载点标记。如果该 inode 是一个文件系统的挂载点（Mount Point），此标志置 1。
     unsigned char i_seek;           ///< 寻址标记，内部使用，通常与文件偏移量相关，标记是否需要进行特殊的寻址操作。
     unsigned char i_update;         ///< 更新标记，辅助标志，用于标记某些特定的更新状态，配合 i_dirt 使用。
+    /* 下面的链表指针在清空 inode 时保留 */
+    struct m_inode * i_hash_next;   ///< (i_dev, i_num) 哈希链，i_dev 不为 0 的 inode 都在哈希表中。
+    struct m_inode * i_hash_prev;
+    struct m_inode * i_free_next;   ///< 空闲 inode 环形 LRU 链表，i_count 为 0 的 inode 都在上面。
+    struct m_inode * i_free_prev;
 };
 
 /**
@@ -144,6 +185,9 @@ struct file
     unsigned short f_count;         ///< 文件引用计数
     struct m_inode * f_inode;       ///< 指向内存 inode
     off_t f_pos;                    ///< 当前文件位置，偏移量
+    unsigned short f_reada;         ///< 顺序读的预读窗口（块数），0 表示不预读
+    long f_ralast;                  ///< 上一次读到的文件逻辑块号，用于判断是否顺序读
+    long f_raend;                   ///< 已经发起过预读的最后一个逻辑块号之后的块号
 };
 
 /**
@@ -200,7 +244,8 @@ struct dir_entry
     char name[NAME_LEN];        ///< 文件名。固定长度字符数组。
 };
 
-extern struct m_inode inode_table[NR_INODE];
+extern struct m_inode * inode_table;
+extern int nr_inodes;
 extern struct file file_table[NR_FILE];
 extern struct super_block super_block[NR_SUPER];
 extern struct buffer_head * start_buffer;
@@ -212,6 +257,9 @@ extern int ticks_to_floppy_on(unsigned int dev);
 extern void floppy_on(unsigned int dev);
 extern void floppy_off(unsigned int dev);
 extern void truncate(struct m_inode * inode);
+extern void insert_inode_hash(struct m_inode * inode);
+extern void clear_inode(struct m_inode * inode);
+extern void invalidate_dcache(int dev);
 extern void sync_inodes(void);
 extern void wait_on(struct m_inode * inode);
 extern int bmap(struct m_inode * inode,int block);
@@ -223,6 +271,7 @@ extern void iput(struct m_inode * inode);
 extern struct m_inode * iget(int dev,int nr);
 extern struct m_inode * get_empty_inode(void);
 extern struct m_inode * get_pipe_inode(void);
+extern void free_pipe_pages(struct m_inode * inode);
 extern struct buffer_head * get_hash_table(int dev, int block);
 extern struct buffer_head * getblk(int dev, int block);
 extern void ll_rw_block(int rw, struct buffer_head * bh);
@@ -230,6 +279,8 @@ extern void brelse(struct buffer_head * buf);
 extern struct buffer_head * bread(int dev,int block);
 extern void bread_page(unsigned long addr,int dev,int b[4]);
 extern struct buffer_head * breada(int dev,int block,...);
+extern void bread_ahead(int dev, int block);
+extern struct buffer_head * bread_wait(struct buffer_head * bh);
 extern int new_block(int dev);
 extern void free_block(int dev, int block);
 extern struct m_inode * new_inode(int dev);
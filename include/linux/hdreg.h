@@ -14,11 +14,13 @@
 #define HD_LCYL		0x1f4       /* starting cylinder */
 #define HD_HCYL		0x1f5       /* high byte of starting cyl */
 #define HD_CURRENT	0x1f6       /* 101dhhhh , d=drive, hhhh=head */
+#define HD_LBA		0x40        /* HD_CURRENT 中的 LBA 位：1L1dhhhh，hhhh 为 LBA 的 24~27 位 */
 #define HD_STATUS	0x1f7       /* 硬盘状态寄存器 */
 #define HD_PRECOMP HD_ERROR     /* same io address, read=error, write=precomp */
 #define HD_COMMAND HD_STATUS	/* same io address, read=status, write=cmd */
 
 #define HD_CMD		0x3f6
+#define HD_CTL_NIEN	0x02	/* 写 HD_CMD：禁止驱动器产生中断 */
 
 /* Bits of HD_STATUS */
 #define ERR_STAT	0x01
@@ -40,6 +42,28 @@
 #define WIN_SEEK 		0x70
 #define WIN_DIAGNOSE		0x90
 #define WIN_SPECIFY		0x91
+#define WIN_MULTREAD		0xC4	/* READ MULTIPLE：每次中断传输一组扇区 */
+#define WIN_MULTWRITE		0xC5	/* WRITE MULTIPLE */
+#define WIN_SETMULT		0xC6	/* SET MULTIPLE MODE：扇区数寄存器为每组扇区数 */
+#define WIN_IDENTIFY		0xEC	/* IDENTIFY DEVICE：读出 256 字的驱动器识别数据 */
+#define WIN_READDMA		0xC8	/* READ DMA：由总线主控 DMA 传输，整个命令结束才产生一次中断 */
+#define WIN_WRITEDMA		0xCA	/* WRITE DMA */
+
+/* PCI IDE bus-master DMA registers, relative to BAR4 (primary channel) */
+#define BM_COMMAND	0	/* 命令寄存器 */
+#define BM_STATUS	2	/* 状态寄存器 */
+#define BM_PRD		4	/* PRD 表物理地址（4 字节） */
+
+/* Bits of BM_COMMAND */
+#define BM_CMD_START	0x01	/* 开始/停止传输 */
+#define BM_CMD_READ	0x08	/* 传输方向：1 为读硬盘（写内存） */
+
+/* Bits of BM_STATUS */
+#define BM_STAT_ACTIVE	0x01	/* 正在传输 */
+#define BM_STAT_ERR	0x02	/* 传输出错，写 1 清除 */
+#define BM_STAT_INTR	0x04	/* 驱动器发出了中断，写 1 清除 */
+
+#define BM_PRD_EOT	0x80000000	/* PRD 表项字节数中的结束标志 */
 
 /* Bits for HD_ERROR */
 #define MARK_ERR	0x01	/* Bad address mark ? */
@@ -5,8 +5,11 @@ typedef struct desc_struct {
 	unsigned long a,b;
 } desc_table[256];
 
+#define NR_GDT 516	/* 4 + 2*NR_TASKS，必须和 boot/head.s 中 _gdt 的大小一致 */
+
 extern unsigned long pg_dir[1024];
-extern desc_table idt, gdt;
+extern desc_table idt;
+extern struct desc_struct gdt[NR_GDT];
 
 #define GDT_NUL 0
 #define GDT_CODE 1
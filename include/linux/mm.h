@@ -3,8 +3,41 @@
 
 #define PAGE_SIZE 4096
 
+/*
+ * 每个进程有自己的页目录（tss.cr3），前 TASK_BASE 部分和 pg_dir 相同（内核的 16MB 恒等映射），
+ * 进程的用户空间都放在线性地址 TASK_BASE 开始的 TASK_SIZE 字节里。
+ */
+#define TASK_BASE 0x4000000
+#define TASK_SIZE 0x4000000
+/* 页目录 dir（物理地址）中管理线性地址 addr 的目录项 */
+#define PDE(dir,addr) ((unsigned long *) (dir) + ((unsigned long) (addr) >> 22))
+
+#define NR_MMAP 8          /* 每个进程最多的文件映射个数 */
+#define MMAP_BASE 0x2000000 /* 文件映射从进程空间 32MB 处往上分配（在 brk 之上） */
+
+/* 进程的一个文件映射，地址都是相对进程数据段的偏移，vm_inode 为 NULL 表示空闲 */
+struct vm_area {
+    unsigned long vm_start;
+    unsigned long vm_end;
+    unsigned long vm_offset;        /* 映射起点在文件中的偏移，页对齐 */
+    int vm_prot;                    /* PROT_READ/PROT_WRITE */
+    struct m_inode * vm_inode;
+};
+
+#define GFP_ZERO 1      /* 页面必须清零。调用者会覆盖整页时不要设置，可以省掉清零 */
+
 extern unsigned long get_free_page(void);
+extern unsigned long __get_free_page(int flags);
+extern void refill_zero_pages(void);
+extern void invalidate_text_pages(int dev, int ino);
+extern unsigned long map_page(unsigned long page,unsigned long address,int prot);
+extern void unmap_page_range(unsigned long from,unsigned long size);
+extern int mmap_no_page(unsigned long address);
+extern int mmap_overlap(unsigned long start,unsigned long end);
+extern int mmap_write_denied(unsigned long address);
+extern void exit_mmap(void);
 extern unsigned long put_page(unsigned long page,unsigned long address);
+extern unsigned long new_page_dir(void);
 extern void free_page(unsigned long addr);
 
 #endif
@@ -1,7 +1,7 @@
 #ifndef _SCHED_H
 #define _SCHED_H
 
-#define NR_TASKS 64
+#define NR_TASKS 256
 #define HZ 100                        /* 每秒时钟中断 100 次。*/
 
 #define FIRST_TASK task[0]            /* 第一个进程 */
@@ -26,11 +26,28 @@
 #define NULL ((void *) 0)
 #endif
 
-extern int copy_page_tables(unsigned long from, unsigned long to, long size);
-extern int free_page_tables(unsigned long from, unsigned long size);
+/*
+ * 定时器：到了 jiffies 为 expires 的那个时钟滴答，在时钟中断里（关着中断）调用 fn(data)。
+ * 结构由使用者提供（静态的或者嵌在别的结构里），所以个数没有限制。
+ * pprev 不为 NULL 表示定时器挂在时间轮上还没到期。
+ */
+struct timer_list {
+    struct timer_list * next;
+    struct timer_list ** pprev;
+    unsigned long expires;
+    unsigned long data;
+    void (*fn)();
+};
+
+#define timer_pending(t) ((t)->pprev != NULL)
+
+extern int copy_page_tables(unsigned long from_dir, unsigned long to_dir,
+	unsigned long from, unsigned long to, long size);
+extern int free_page_tables(unsigned long dir, unsigned long from, unsigned long size);
 
 extern void sched_init(void);
 extern void schedule(void);
+extern int vfork_release(int exiting);
 extern void trap_init(void);
 extern void panic(const char * str);
 extern int tty_write(unsigned minor,char * buf,int count);
@@ -115,6 +132,11 @@ struct task_struct
     struct desc_struct ldt[3];
 /* tss for this task */
     struct tss_struct tss;
+    struct task_struct * vfork_parent;  ///< vfork 出来、还借用着父进程地址空间的子进程指向父进程，exec 或 exit 时清空并唤醒父进程。
+    struct vm_area mmap[NR_MMAP];       ///< 文件映射描述符（mmap）。
+    struct task_struct * run_next, * run_prev;  ///< 运行队列链表，见 sched.c。
+    long run_level;                     ///< 所在的运行队列下标，-1 表示不在运行队列上。
+    struct timer_list alarm_timer;      ///< alarm 到期时发 SIGALRM 的定时器，见 set_alarm。
 };
 
 /*
@@ -142,6 +164,10 @@ struct task_struct
      _LDT(0),0x80000000, \
         {} \
     }, \
+/* vfork */    NULL, \
+/* mmap */    {}, \
+/* run queue */    NULL,NULL,-1, \
+/* alarm timer */    {NULL,NULL,0,0,NULL}, \
 }
 
 extern struct task_struct *task[NR_TASKS];
@@ -149,13 +175,20 @@ extern struct task_struct *last_task_used_math;
 extern struct task_struct *current;
 extern long volatile jiffies;
 extern long startup_time;
+extern long nr_switches;
 
 #define CURRENT_TIME (startup_time + jiffies / HZ)          /* 当前系统时间。*/
 
-extern void add_timer(long jiffies, void (*fn)(void));
+extern void add_timer(struct timer_list * timer);
+extern int del_timer(struct timer_list * timer);
 extern void sleep_on(struct task_struct ** p);
 extern void interruptible_sleep_on(struct task_struct ** p);
+extern long sleep_on_timeout(struct task_struct ** p, long timeout);
+extern long interruptible_sleep_on_timeout(struct task_struct ** p, long timeout);
 extern void wake_up(struct task_struct ** p);
+extern void wake_up_process(struct task_struct * p);
+extern void signal_wake_up(struct task_struct * p);
+extern void set_alarm(long expires);
 
 /*
  * Entry into gdt where to find first TSS. 0-nul, 1-cs, 2-ds, 3-syscall
@@ -163,8 +196,12 @@ extern void wake_up(struct task_struct ** p);
  */
 #define FIRST_TSS_ENTRY 4    /* 第一个 tss 的位置在 gdt 表中下标 */
 #define FIRST_LDT_ENTRY (FIRST_TSS_ENTRY+1)
+#if (FIRST_TSS_ENTRY+2*NR_TASKS > NR_GDT)
+#error "NR_TASKS needs more GDT entries, see boot/head.s"
+#endif
 #define _TSS(n) ((((unsigned long) n)<<4)+(FIRST_TSS_ENTRY<<3))    /* 计算进程 n 的 tss 选择子。为什么左移 4 位，选择子最后 3 位为属性位，又多左移 1 位是因为每个进程拥有 2 个 gdt 表项 */
 #define _LDT(n) ((((unsigned long) n)<<4)+(FIRST_LDT_ENTRY<<3))
+#define TASK_NR(p) (((p)->tss.ldt-(FIRST_LDT_ENTRY<<3))>>4)   /* 由 ldt 选择子反推进程在 task[] 中的下标 */
 #define ltr(n) __asm__("ltr %%ax"::"a" (_TSS(n)))
 #define lldt(n) __asm__("lldt %%ax"::"a" (_LDT(n)))
 #define str(n) \
@@ -0,0 +1,25 @@
+#ifndef _SYS_MMAN_H
+#define _SYS_MMAN_H
+
+#include <sys/types.h>
+
+#define PROT_NONE	0x0
+#define PROT_READ	0x1		/* page can be read */
+#define PROT_WRITE	0x2		/* page can be written (only for MAP_PRIVATE) */
+#define PROT_EXEC	0x4		/* page can be executed */
+
+#define MAP_SHARED	0x01		/* read-only, shares the file contents */
+#define MAP_PRIVATE	0x02		/* changes are private to the process */
+#define MAP_TYPE	0x0f
+
+#define MAP_FAILED	((void *) -1)
+
+/*
+ * mmap takes its six arguments through a block in user memory:
+ * { addr, len, prot, flags, fd, offset }. addr is only a hint and is
+ * ignored; offset must be a multiple of the page size.
+ */
+extern void * mmap(void * addr, size_t len, int prot, int flags, int fd, off_t off);
+extern int munmap(void * addr, size_t len);
+
+#endif
@@ -33,10 +33,17 @@ struct tm
                     ///< ʱ 7:00ӱʾʵ϶Ӧԭ 8:00ǰһСʱ𴲹
 };
 
+/* nanosleep() */
+struct timespec {
+    time_t tv_sec;
+    long tv_nsec;
+};
+
 clock_t clock(void);
 time_t time(time_t * tp);
 double difftime(time_t time2, time_t time1);
 time_t mktime(struct tm * tp);
+int nanosleep(const struct timespec * req, struct timespec * rem);
 
 char * asctime(const struct tm * tp);
 char * ctime(const time_t * tp);
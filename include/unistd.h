@@ -129,6 +129,12 @@
 #define __NR_ssetmask	69
 #define __NR_setreuid	70
 #define __NR_setregid	71
+#define __NR_bdflush	72
+#define __NR_vfork	73
+#define __NR_mmap	74
+#define __NR_munmap	75
+#define __NR_splice	76
+#define __NR_nanosleep	77
 
 #define _syscall0(type,name) \
 type name(void) \
@@ -18,6 +18,7 @@ static inline _syscall0(int,fork)                   /* 会调用 _system_call */
 static inline _syscall0(int,pause)
 static inline _syscall1(int, setup, void *, BIOS)   /* sys_call_table，BIOS：bios中存储的磁盘信息。*/
 static inline _syscall0(int,sync)
+static inline _syscall2(int,bdflush,int,func,long,data)
 
 #include <linux/tty.h>
 #include <linux/sched.h>
@@ -43,6 +44,7 @@ extern void hd_init(void);
 extern void floppy_init(void);
 extern void mem_init(long start, long end);
 extern long rd_init(long mem_start, int length);
+extern long inode_init(long mem_start, long mem_end);
 extern long kernel_mktime(struct tm * tm);
 extern long startup_time;
 
@@ -122,6 +124,7 @@ void main(void)        /* This really IS void, no error here. */
 #ifdef RAMDISK
     main_memory_start += rd_init(main_memory_start, RAMDISK*1024);
 #endif
+    main_memory_start += inode_init(main_memory_start, memory_end);    ///< inode 表紧跟在缓冲区（或虚拟盘）之后
     mem_init(main_memory_start, memory_end);            ///< memory_end 可用内存结尾。
     trap_init();
     blk_dev_init();
@@ -175,6 +178,11 @@ void init(void)
     printf("%d buffers = %d bytes buffer space\n\r",NR_BUFFERS,
         NR_BUFFERS*BLOCK_SIZE);
     printf("Free mem: %d bytes\n\r",memory_end-main_memory_start);
+    if (!(pid=fork())) {                    ///< 后台写回守护进程，把老化的脏缓冲块写回磁盘，正常情况下不会返回。
+        close(0);close(1);close(2);
+        bdflush(0, 0);
+        _exit(0);
+    }
     if (!(pid=fork())) {
         close(0);
         if (open("/etc/rc",O_RDONLY,0))
@@ -14,6 +14,12 @@
  */
 #define NR_REQUEST	32
 
+/*
+ * 相邻的缓冲块会被合并进同一个请求，一个请求最多的扇区数受硬盘控制器
+ * 扇区计数寄存器限制（8 位，写 0 表示 256 个扇区）。
+ */
+#define MAX_SECTORS	256
+
 /**
  * @brief 磁盘请求结构体
  */
@@ -23,28 +29,50 @@ struct request
 	int cmd;						///< READ 或 WRITE
 	int errors;
 	unsigned long sector;			///< 要读写位置的扇区号，相对于该分区起始位置的逻辑扇区号
-	unsigned long nr_sectors;		///< 要读写的扇区数
-	char * buffer;					///< 完成磁盘读取后，会将数据写入 buffer 中，buffer 为 buffer_head 指向的内存，即 buffer_head->b_data。
+	unsigned long nr_sectors;		///< 要读写的扇区数，合并后为链上所有缓冲块剩余扇区数之和
+	unsigned long current_nr_sectors;	///< 当前缓冲块（bh）中剩余的扇区数
+	char * buffer;					///< 完成磁盘读取后，会将数据写入 buffer 中，buffer 为当前缓冲块 bh->b_data 中的传输位置。
 	struct task_struct * waiting;	///< 当前发起 IO 请求的进程
-	struct buffer_head * bh;		///< 内存块头
+	struct buffer_head * bh;		///< 当前缓冲块，后续缓冲块通过 b_reqnext 链接
+	struct buffer_head * bhtail;	///< 链上最后一个缓冲块，用于向后合并
+	long deadline;					///< deadline 调度器：超过该时刻（jiffies）仍未处理就优先处理
 	struct request * next;
 };
 
 /*
- * 优先级排序（<）：
- * 1.比较 cmd
- * 2.若 cmd 相等，则比较 dev
- * 3.若 dev 相等，则比较 sector
+ * 磁盘位置排序（<）：
+ * 1.比较 dev
+ * 2.若 dev 相等，则比较 sector
+ * 读写不再分开排序，避免所有读请求都排在写请求前面。
  */
 #define IN_ORDER(s1, s2) \
-(  (s1)->cmd < (s2)->cmd || (s1)->cmd==(s2)->cmd && \
-( (s1)->dev<(s2)->dev || ((s1)->dev==(s2)->dev && (s1)->sector<(s2)->sector) )  )
+( (s1)->dev<(s2)->dev || ((s1)->dev==(s2)->dev && (s1)->sector<(s2)->sector) )
+
+/* deadline 调度器中读、写请求的过期时间（jiffies）：读请求通常有进程在同步等待，给得更短 */
+#define READ_EXPIRE		(HZ/2)
+#define WRITE_EXPIRE	(5*HZ)
+
+struct blk_dev_struct;
+
+/**
+ * @brief IO 调度器（电梯算法）操作表，每个块设备一个，决定请求队列的顺序。
+ * @note 两个函数都在关中断的情况下调用，队列头是驱动正在处理的请求，不能移动。
+ */
+struct iosched_ops {
+	char * name;
+	void (*add_request)(struct blk_dev_struct * dev, struct request * req);	///< 把 req 插入非空队列头之后的某个位置
+	struct request * (*next_request)(struct blk_dev_struct * dev, struct request * done);	///< done 处理完后，返回下一个要处理的请求
+};
 
 struct blk_dev_struct {
 	void (*request_fn)(void);				///< 请求处理函数指针
 	struct request * current_request;		///< 当前正在处理的请求
+	struct iosched_ops * iosched;			///< 请求队列使用的 IO 调度器，blk_dev_init 中按 config.h 设置
 };
 
+extern struct iosched_ops clook_iosched;
+extern struct iosched_ops deadline_iosched;
+
 extern struct blk_dev_struct blk_dev[NR_BLK_DEV];
 extern struct request request[NR_REQUEST];
 extern struct task_struct * wait_for_request;
@@ -106,28 +134,43 @@ extern inline void unlock_buffer(struct buffer_head * bh)
 }
 
 /**
- * @brief 处理结束请求。
- * 更新磁盘处理结果，删除磁盘 IO 队列头的请求（因为这个就是处理第一个 IO 请求的结果），即内存是否映射了磁盘块，
- * 解锁buffer_head，唤醒等待 buffer 的进程。
+ * @brief 结束请求中的当前缓冲块。
+ * 更新当前缓冲块的处理结果，解锁buffer_head，唤醒等待 buffer 的进程。
+ * 如果请求是合并出来的、链上还有缓冲块，则切换到下一块，请求仍留在队列头继续处理；
+ * 否则删除磁盘 IO 队列头的请求（因为这个就是处理第一个 IO 请求的结果）。
+ * @note 当前缓冲块中未传输的扇区（出错时，或者驱动一次传完整块而不逐扇区推进时）在这里跳过。
  */
 extern inline void end_request(int uptodate)
 {
-	DEVICE_OFF(CURRENT->dev);					///< hard disk : do nothing
-	if (CURRENT->bh)
-	{
-		CURRENT->bh->b_uptodate = uptodate;		///< 更新磁盘块是否是最新的
-		unlock_buffer(CURRENT->bh);             ///< 解锁buffer_head，唤醒等待此 buffer 的进程，即使没有读取到磁盘也唤醒，问题让用户进程去处理
-	}
+	struct request * req = CURRENT;
+	struct buffer_head * bh;
+
 	if (!uptodate) 
 	{
 		printk(DEVICE_NAME " I/O error\n\r");   ///< 打印错误日志
-		printk("dev %04x, block %d\n\r",CURRENT->dev,
-			CURRENT->bh->b_blocknr);
+		printk("dev %04x, sector %d\n\r",req->dev,req->sector);
+	}
+	req->sector += req->current_nr_sectors;
+	req->nr_sectors -= req->current_nr_sectors;
+	if (bh = req->bh)
+	{
+		req->bh = bh->b_reqnext;
+		bh->b_reqnext = NULL;
+		bh->b_uptodate = uptodate;		///< 更新磁盘块是否是最新的
+		unlock_buffer(bh);              ///< 解锁buffer_head，唤醒等待此 buffer 的进程，即使没有读取到磁盘也唤醒，问题让用户进程去处理
+		if (bh = req->bh)               ///< 合并的请求还没做完，切换到下一个缓冲块
+		{
+			req->current_nr_sectors = BLOCK_SIZE >> 9;
+			req->buffer = bh->b_data;
+			req->errors = 0;
+			return;
+		}
 	}
-	wake_up(&CURRENT->waiting);     ///< 唤醒等待此信号的进程
+	DEVICE_OFF(req->dev);					///< hard disk : do nothing
+	wake_up(&req->waiting);         ///< 唤醒等待此信号的进程
 	wake_up(&wait_for_request);     ///< 唤醒外层等待队列里的进程
-	CURRENT->dev = -1;              ///< 将请求的设备置空
-	CURRENT = CURRENT->next;        ///< 切换到下一个请求
+	CURRENT = blk_dev[MAJOR_NR].iosched->next_request(blk_dev + MAJOR_NR, req);	///< 由 IO 调度器选出下一个请求
+	req->dev = -1;                  ///< 将请求的设备置空
 }
 
 /* 对 IO 队列进行初步校验。1.无 IO 请求则 return；2.主设备号检测；3.锁定检测。 */
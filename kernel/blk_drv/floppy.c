@@ -398,6 +398,22 @@ static void reset_floppy(void)
 	sti();
 }
 
+static struct timer_list floppy_timer = {NULL,NULL,0,0,NULL};
+
+/* ticks 个滴答之后在时钟中断里调用 fn，ticks <= 0 时马上调用 */
+static void floppy_delay(long ticks, void (*fn)(void))
+{
+	if (ticks <= 0) {
+		cli();
+		fn();
+		sti();
+		return;
+	}
+	floppy_timer.expires = jiffies + ticks;
+	floppy_timer.fn = fn;
+	add_timer(&floppy_timer);
+}
+
 static void floppy_on_interrupt(void)
 {
 /* We cannot do a floppy-select, as that might sleep. We just force it */
@@ -406,7 +422,7 @@ static void floppy_on_interrupt(void)
 		current_DOR &= 0xFC;
 		current_DOR |= current_drive;
 		outb(current_DOR,FD_DOR);
-		add_timer(2,&transfer);
+		floppy_delay(2,&transfer);
 	} else
 		transfer();
 }
@@ -448,7 +464,7 @@ void do_fd_request(void)
 		command = FD_WRITE;
 	else
 		panic("do_fd_request: unknown command");
-	add_timer(ticks_to_floppy_on(current_drive),&floppy_on_interrupt);
+	floppy_delay(ticks_to_floppy_on(current_drive),&floppy_on_interrupt);
 }
 
 void floppy_init(void)
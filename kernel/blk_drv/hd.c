@@ -33,24 +33,32 @@ inb_p(0x71); \
 /* Max read/write errors/sector */
 #define MAX_ERRORS	7           ///< 硬盘最大读写错误次数
 #define MAX_HD		2           ///< 最多硬盘个数
+#define MAX_MULT	16          ///< READ/WRITE MULTIPLE 每组扇区数的上限
 
 static void recal_intr(void);
 
 static int recalibrate = 1;     ///< 在系统刚启动时或硬盘重置时需要重新校准。
 static int reset = 1;           ///< 硬盘重置标识，只在系统刚启动时或磁盘错误过多时需要重置。
+static int setmult = 0;         ///< 需要重新发 SET MULTIPLE MODE 的驱动器位图，硬盘重置后多扇区模式会失效。
+static unsigned int write_count = 0;    ///< 最近一次写给控制器、还没有得到中断确认的扇区数。
+static unsigned short bm_base = 0;      ///< PCI IDE 控制器总线主控寄存器的 I/O 基址，0 表示没有找到，只能用 PIO。
+static unsigned long * prd_table = NULL;    ///< DMA 的 PRD（物理区域描述符）表，每项两个 long：物理地址、字节数。
 /* hd 结构。
  * head：磁头号，标识硬盘的哪个磁头正在读写。sect：逻辑扇区号，指定当前要读写的扇区。
  * cyl：柱面号。wpcom：写预补偿（早起硬盘中，当数据记录在高密度磁介质上时，相邻的磁记录位可能会相互干扰）。
  * lzone：磁头在断电后应该放置的位置（随意放置可能破坏磁盘）。ctl：控制寄存器，控制硬盘的工作模式和操作命令。 */
 struct hd_i_struct {
     int head,sect,cyl,wpcom,lzone,ctl;
+    int mult;       ///< 多扇区模式每次中断传输的扇区数，由 IDENTIFY 数据得出，0 或 1 表示每个扇区一次中断。
+    unsigned long lba_sects;    ///< IDENTIFY 给出的 LBA28 可寻址扇区总数，0 表示不支持 LBA，只能用 CHS 寻址。
+    int dma;        ///< 驱动器支持 DMA 并且找到了总线主控 IDE 控制器，读写请求走 DMA；出错后清零退回 PIO。
 };
 /* 硬盘结构 */
 #ifdef HD_TYPE
     struct hd_i_struct hd_info[] = { HD_TYPE };
     #define NR_HD ((sizeof (hd_info))/(sizeof (struct hd_i_struct)))
 #else
-    struct hd_i_struct hd_info[] = { {0,0,0,0,0,0},{0,0,0,0,0,0} };
+    struct hd_i_struct hd_info[] = { {0,0,0,0,0,0,0,0,0},{0,0,0,0,0,0,0,0,0} };
     static int NR_HD = 0;    ///< 记录硬盘个数，后续在 bios 读取硬盘信息和 cmos 获取硬盘信息会修改
 #endif
 
@@ -61,6 +69,9 @@ static struct hd_struct
     long nr_sects;          ///< 分区大小（扇区数）
 } hd[5 * MAX_HD]={{0,0},};  ///< 每个盘有 5 个分区。
 
+/* 驱动器每次中断传输的扇区数 */
+#define HD_MULT(drive) (hd_info[drive].mult > 1 ? hd_info[drive].mult : 1)
+
 /* 从端口读取（nr * 2）字节到buf中 */
 #define port_read(port, buf, nr) \
 __asm__("cld;rep;insw"::"d" (port),"D" (buf),"c" (nr):"cx","di")
@@ -91,10 +102,15 @@ int sys_setup(void * BIOS)
         return -1;
     callable = 0;
 
-    /// 读取磁盘信息。
+    /// 读取磁盘信息。BIOS 中没有的驱动器保留 hd_init 时从 IDENTIFY 数据得到的几何参数。
 #ifndef HD_TYPE
     for (drive=0 ; drive<2 ; drive++) 
     {
+        if (!*(unsigned char *) (14 + BIOS))
+        {
+            BIOS += 16;
+            continue;
+        }
         hd_info[drive].cyl = *(unsigned short *) BIOS;
         hd_info[drive].head = *(unsigned char *) (2 + BIOS);
         hd_info[drive].wpcom = *(unsigned short *) (5 + BIOS);
@@ -108,10 +124,13 @@ int sys_setup(void * BIOS)
     else
         NR_HD = 1;
 #endif
-    for (i=0 ; i < NR_HD ; i++)         ///< hd[0] 是整个硬盘（hda），参数来自 BIOS（CMOS）。
+    for (i=0 ; i < NR_HD ; i++)         ///< hd[0] 是整个硬盘（hda），支持 LBA 时用 IDENTIFY 给出的容量，否则由 BIOS（CMOS）几何参数算出。
     {
         hd[i*5].start_sect = 0;
-        hd[i*5].nr_sects = hd_info[i].head * hd_info[i].sect * hd_info[i].cyl;
+        if (hd_info[i].lba_sects)
+            hd[i*5].nr_sects = hd_info[i].lba_sects;
+        else
+            hd[i*5].nr_sects = hd_info[i].head * hd_info[i].sect * hd_info[i].cyl;
     }
     /// 一些硬盘控制器与BIOS兼容，所以会出现在 BIOS 表中，另外一些不兼容，需要从寄存器里面读取
     if ((cmos_disks = CMOS_READ(0x12)) & 0xf0)
@@ -197,8 +216,8 @@ static void hd_out(unsigned int drive, unsigned int nsect, unsigned int sect,
 {
     register int port asm("dx");                ///< 凡是涉及到 port 的操作都用 dx。
 
-    if (drive>1 || head>15)                     ///< linux0.11 最多支持 2 个 IDE 硬盘，0 是主盘，1 是从盘
-        panic("Trying to write bad sector");    ///< head 为磁头号，用 4 位表示，所以最大为 15
+    if (drive>1 || (head & ~HD_LBA)>15)         ///< linux0.11 最多支持 2 个 IDE 硬盘，0 是主盘，1 是从盘
+        panic("Trying to write bad sector");    ///< head 为磁头号（LBA 模式下为 LBA 的 24~27 位），用 4 位表示，所以最大为 15
     if (!controller_ready())
         panic("HD controller not ready");
     do_hd = intr_addr;
@@ -244,6 +263,7 @@ static void reset_controller(void)
 /* 复位硬盘 */
 static void reset_hd(int nr)
 {
+    setmult = (1 << MAX_HD) - 1;        ///< 复位后驱动器回到单扇区模式
     reset_controller();                 ///< 复位硬盘控制器
     hd_out(nr,hd_info[nr].sect,hd_info[nr].sect,hd_info[nr].head-1,
         hd_info[nr].cyl,WIN_SPECIFY,&recal_intr);       ///< 设置完硬盘参数后会产生IRQ14中断，对应中断向量0x2E。
@@ -263,25 +283,72 @@ static void bad_rw_intr(void)
         reset = 1;
 }
 
+/**
+ * @brief 请求的进度推进一个扇区，当前缓冲块传完了就结束它（合并的请求会切换到下一个缓冲块）。
+ */
+static inline void next_sector(void)
+{
+    CURRENT->buffer += 512;
+    CURRENT->sector++;
+    CURRENT->nr_sectors--;
+    if (!--CURRENT->current_nr_sectors)
+        end_request(1);
+}
+
+/**
+ * @brief 向控制器写出一组扇区（多扇区模式下最多 mult 个），数据沿请求的缓冲块链取，不推进请求的进度。
+ * @details 进度要等写完这组扇区的中断确认后，才在 write_intr 中推进，出错时才能从原位置重试。
+ */
+static void write_block(void)
+{
+    struct buffer_head * bh = CURRENT->bh;
+    char * buf = CURRENT->buffer;
+    unsigned long left = CURRENT->current_nr_sectors;
+    unsigned int i;
+
+    write_count = HD_MULT(CURRENT_DEV);
+    if (write_count > CURRENT->nr_sectors)
+        write_count = CURRENT->nr_sectors;
+    for (i = 0; i < write_count; i++)
+    {
+        if (!left)          ///< 当前缓冲块写完了，接着写链上的下一个缓冲块
+        {
+            bh = bh->b_reqnext;
+            buf = bh->b_data;
+            left = BLOCK_SIZE >> 9;
+        }
+        port_write(HD_DATA, buf, 256);
+        buf += 512;
+        left--;
+    }
+}
+
 /* 读取硬盘到映射的相应的缓冲区中，对blk_dev[hd]内部积攒的请求进行连续处理 */
 static void read_intr(void)
 {
+    unsigned long count, left;
+
     if (win_result()) 
     {     ///< 获取硬盘处理结果
         bad_rw_intr();
         do_hd_request();    ///< 如果读盘出错，则重置硬盘，重新校准
         return;
     }
-    port_read(HD_DATA, CURRENT->buffer, 256);   ///< 从 0x1F0 端口读取 512 字节到 buffer 中。
     CURRENT->errors = 0;
-    CURRENT->buffer += 512;
-    CURRENT->sector++;
-    if (--CURRENT->nr_sectors) 
+    count = HD_MULT(CURRENT_DEV);   ///< 多扇区模式下一次中断可以读出一组扇区
+    if (count > CURRENT->nr_sectors)
+        count = CURRENT->nr_sectors;
+    left = CURRENT->nr_sectors - count;
+    while (count--)
     {
-        do_hd = &read_intr; ///< 如果要读取的扇区个数不为 0，则继续读取。（硬盘控制器在读取完一个扇区后，会自动准备下一个扇区，并再次触发 IRQ14。）
+        port_read(HD_DATA, CURRENT->buffer, 256);   ///< 从 0x1F0 端口读取 512 字节到 buffer 中。
+        next_sector();
+    }
+    if (left) 
+    {
+        do_hd = &read_intr; ///< 如果要读取的扇区个数不为 0，则继续读取。（硬盘控制器在读取完一组扇区后，会自动准备下一组，并再次触发 IRQ14。）
         return;
     }
-    end_request(1);
     do_hd_request();        ///< 如果有请求，继续处理下一个请求。
 }
 
@@ -290,24 +357,86 @@ static void read_intr(void)
  */
 static void write_intr(void)
 {
+    unsigned long count, left;
+
     if (win_result()) 
     {
         bad_rw_intr();
         do_hd_request();
         return;
     }
-    if (--CURRENT->nr_sectors) 
+    count = write_count;            ///< 上一组扇区已经写好，推进请求进度
+    left = CURRENT->nr_sectors - count;
+    while (count--)
+        next_sector();
+    if (left) 
     {
-        CURRENT->sector++;
-        CURRENT->buffer += 512;
         do_hd = &write_intr;
-        port_write(HD_DATA, CURRENT->buffer, 256);
+        write_block();
         return;
     }
-    end_request(1);
     do_hd_request();    ///< 继续处理下一个请求
 }
 
+/**
+ * @brief 按请求的缓冲块链填写 PRD 表，每个缓冲块一项，最后一项置 EOT。
+ * @details 第一项从请求当前的传输位置开始（出错重试时可能在缓冲块中间）。缓冲块 1KB 对齐，
+ * 不会跨越 DMA 要求的 64KB 边界；内核空间线性地址就是物理地址。
+ */
+static void build_prd(void)
+{
+    struct buffer_head * bh = CURRENT->bh;
+    unsigned long * prd = prd_table;
+
+    prd[0] = (unsigned long) CURRENT->buffer;
+    prd[1] = CURRENT->current_nr_sectors << 9;
+    while (bh = bh->b_reqnext)
+    {
+        prd += 2;
+        prd[0] = (unsigned long) bh->b_data;
+        prd[1] = BLOCK_SIZE;
+    }
+    prd[1] |= BM_PRD_EOT;
+}
+
+/**
+ * @brief DMA 读写完成的 IRQ14 回调，整个请求只有这一次中断。
+ * @details 出错时关闭该驱动器的 DMA，按普通错误处理后由 do_hd_request 用 PIO 重试。
+ */
+static void dma_intr(void)
+{
+    unsigned char stat;
+    unsigned long count;
+
+    outb(inb(bm_base + BM_COMMAND) & ~BM_CMD_START, bm_base + BM_COMMAND);   ///< 停止总线主控
+    stat = inb(bm_base + BM_STATUS);
+    outb(stat | BM_STAT_ERR | BM_STAT_INTR, bm_base + BM_STATUS);
+    if (win_result() || (stat & BM_STAT_ERR))
+    {
+        printk("hd%d: DMA error, using PIO\n\r", CURRENT_DEV);
+        hd_info[CURRENT_DEV].dma = 0;
+        bad_rw_intr();
+        do_hd_request();
+        return;
+    }
+    CURRENT->errors = 0;
+    count = CURRENT->nr_sectors;    ///< 整个请求都传完了，结束链上所有缓冲块
+    while (count--)
+        next_sector();
+    do_hd_request();
+}
+
+/* SET MULTIPLE MODE 的 IRQ14 回调，驱动器不接受就退回单扇区模式 */
+static void setmult_intr(void)
+{
+    if (win_result())
+    {
+        printk("hd%d: set multiple mode failed, using single sector mode\n\r", CURRENT_DEV);
+        hd_info[CURRENT_DEV].mult = 1;
+    }
+    do_hd_request();
+}
+
 /* 硬盘初始化（WIN_SPECIFY）和重置硬盘磁头的操作（WIN_RESTORE），属于 IRQ14 的回调 */
 static void recal_intr(void)
 {
@@ -332,19 +461,28 @@ void do_hd_request(void)
     block = CURRENT->sector;        ///< 起始扇区号。
 
     /// 判断是否超出最大设备号，待读取的设备块不能越界
-    if (dev >= 5 * NR_HD || block + 2 > hd[dev].nr_sects) 
+    if (dev >= 5 * NR_HD || block + CURRENT->nr_sectors > hd[dev].nr_sects) 
     {
         end_request(0);
         goto repeat;
     }
     block += hd[dev].start_sect;    ///< 要读写的硬盘的全局绝对扇区编号。
     dev /= 5;                       ///< 计算是第几个硬盘。
-    __asm__("divl %4":"=a" (block),"=d" (sec):"0" (block),"1" (0),
-        "r" (hd_info[dev].sect));
-    __asm__("divl %4":"=a" (cyl),"=d" (head):"0" (block),"1" (0),
-        "r" (hd_info[dev].head));
-    sec++;
-    nsect = CURRENT->nr_sectors;    ///< 要读写扇区数
+    if (hd_info[dev].lba_sects)     ///< LBA28：扇区号直接拆到 sector/cyl/head 寄存器，不需要除法
+    {
+        sec = block & 0xff;
+        cyl = (block >> 8) & 0xffff;
+        head = ((block >> 24) & 0x0f) | HD_LBA;
+    }
+    else
+    {
+        __asm__("divl %4":"=a" (block),"=d" (sec):"0" (block),"1" (0),
+            "r" (hd_info[dev].sect));
+        __asm__("divl %4":"=a" (cyl),"=d" (head):"0" (block),"1" (0),
+            "r" (hd_info[dev].head));
+        sec++;
+    }
+    nsect = CURRENT->nr_sectors;    ///< 要读写扇区数，合并的请求一条命令传完，256 时写入扇区计数寄存器的是 0
 
     /* 重置硬盘 */
     if (reset) 
@@ -362,10 +500,33 @@ void do_hd_request(void)
             WIN_RESTORE, &recal_intr);      ///< 恢复命令（Restore），用于将磁头移回 0 号柱面（即归位）
         return;
     }
+    /* 重新设置多扇区模式 */
+    if (setmult & (1 << dev))
+    {
+        setmult &= ~(1 << dev);
+        if (hd_info[dev].mult > 1)
+        {
+            hd_out(dev, hd_info[dev].mult, 0, 0, 0, WIN_SETMULT, &setmult_intr);
+            return;
+        }
+    }
 
+    if (hd_info[dev].dma && (CURRENT->cmd == READ || CURRENT->cmd == WRITE))
+    {
+        /// 总线主控 DMA：填好 PRD 表、设置方向并清除状态，发出命令后再启动 DMA，整个请求结束时才中断一次
+        build_prd();
+        outl((unsigned long) prd_table, bm_base + BM_PRD);
+        outb(CURRENT->cmd == READ ? BM_CMD_READ : 0, bm_base + BM_COMMAND);
+        outb(inb(bm_base + BM_STATUS) | BM_STAT_ERR | BM_STAT_INTR, bm_base + BM_STATUS);
+        hd_out(dev, nsect, sec, head, cyl,
+            CURRENT->cmd == READ ? WIN_READDMA : WIN_WRITEDMA, &dma_intr);
+        outb(inb(bm_base + BM_COMMAND) | BM_CMD_START, bm_base + BM_COMMAND);
+        return;
+    }
     if (CURRENT->cmd == WRITE)      ///< 写请求
     {
-        hd_out(dev, nsect, sec, head, cyl, WIN_WRITE, &write_intr);
+        hd_out(dev, nsect, sec, head, cyl,
+            hd_info[dev].mult > 1 ? WIN_MULTWRITE : WIN_WRITE, &write_intr);
         /// 等待硬盘处理结果
         for(i = 0; i < 3000 && !(r = inb_p(HD_STATUS) & DRQ_STAT); i++)
             /* nothing */ ;
@@ -375,21 +536,140 @@ void do_hd_request(void)
             goto repeat;
         }
         /* 硬盘控制器在收到 WIN_WRITE 后并不会直接触发 IRQ14，而是等待数据写入，
-        写完1个扇区后（512字节）才触发 IRQ14 中断，进入 0x2E 中断处理程序。*/
-        port_write(HD_DATA, CURRENT->buffer, 256);
+        写完1个扇区（多扇区模式下为一组扇区）后才触发 IRQ14 中断，进入 0x2E 中断处理程序。*/
+        write_block();
     } 
     else if (CURRENT->cmd == READ)  ///< 读请求
     {  
-        hd_out(dev, nsect, sec, head, cyl, WIN_READ, &read_intr);   ///< 发出读取硬盘扇区命令。dev = 0, nsect = 2, sec = 起始扇区。
+        hd_out(dev, nsect, sec, head, cyl,
+            hd_info[dev].mult > 1 ? WIN_MULTREAD : WIN_READ, &read_intr);  ///< 发出读取硬盘扇区命令。dev = 0, nsect = 2, sec = 起始扇区。
     } 
     else
         panic("unknown hd-command");
 }
 
-/* 设置硬盘中断函数，清除对主硬盘中断的屏蔽 */
+/**
+ * @brief 以轮询方式向驱动器 drive 发出 IDENTIFY DEVICE，读出 256 字的识别数据到 id 中。
+ * @details 只在 hd_init 中调用：此时还没有开中断，IRQ14 也仍被屏蔽，并且通过 nIEN 禁止了驱动器中断。
+ * @return 0 成功；-1 驱动器不存在，或者是不支持 IDENTIFY 的老式控制器。
+ */
+static int hd_identify(int drive, unsigned short * id)
+{
+    int i, stat;
+
+    outb_p(0xA0 | (drive << 4), HD_CURRENT);
+    for (i = 0; i < 10000 && ((stat = inb_p(HD_STATUS)) & BUSY_STAT); i++)
+        /* nothing */ ;
+    if (stat == 0xff || (stat & (BUSY_STAT | READY_STAT)) != READY_STAT)  ///< 总线悬空或驱动器不存在
+        return -1;
+    outb_p(WIN_IDENTIFY, HD_COMMAND);
+    for (i = 0; i < 100000 && ((stat = inb_p(HD_STATUS)) & BUSY_STAT); i++)
+        /* nothing */ ;
+    if ((stat & (BUSY_STAT | ERR_STAT | DRQ_STAT)) != DRQ_STAT)
+        return -1;
+    port_read(HD_DATA, id, 256);
+    return 0;
+}
+
+/* PCI 配置空间访问（配置机制 #1），只扫描 0 号总线 */
+#define PCI_CONF_ADDR(dev,fn,reg) (0x80000000 | ((dev) << 11) | ((fn) << 8) | (reg))
+
+static unsigned long pci_read(int dev, int fn, int reg)
+{
+    outl(PCI_CONF_ADDR(dev, fn, reg), 0xCF8);
+    return inl(0xCFC);
+}
+
+static void pci_write(int dev, int fn, int reg, unsigned long val)
+{
+    outl(PCI_CONF_ADDR(dev, fn, reg), 0xCF8);
+    outl(val, 0xCFC);
+}
+
+/**
+ * @brief 在 PCI 总线上寻找支持总线主控的 IDE 控制器（如 QEMU 模拟的 PIIX），记下 BAR4 的 I/O 基址。
+ * @details 类代码 0x0101 为 IDE 控制器，编程接口 bit 7 表示支持总线主控。
+ * 同时打开控制器的 I/O 访问和总线主控使能位，并分配一页内存作为 PRD 表（页对齐，不跨 64KB 边界）。
+ * 没有 PCI 或者没有找到时 bm_base 保持为 0，所有请求使用 PIO。
+ */
+static void hd_dma_probe(void)
+{
+    unsigned long class, bar;
+    int dev, fn;
+
+    outl(0x80000000, 0xCF8);
+    if (inl(0xCF8) != 0x80000000)       ///< 没有配置机制 #1，不是 PCI 机器
+        return;
+    for (dev = 0; dev < 32; dev++)
+        for (fn = 0; fn < 8; fn++)
+        {
+            if ((pci_read(dev, fn, 0) & 0xffff) == 0xffff)
+            {
+                if (!fn)
+                    break;
+                continue;
+            }
+            class = pci_read(dev, fn, 8) >> 8;
+            if ((class >> 8) != 0x0101 || !(class & 0x80))
+                continue;
+            bar = pci_read(dev, fn, 0x20);
+            if (!(bar & 1) || !(bar & 0xfffc))  ///< 必须是 I/O 空间并且已经分配了地址
+                continue;
+            if (!(prd_table = (unsigned long *) get_free_page()))
+                return;
+            pci_write(dev, fn, 4, pci_read(dev, fn, 4) | 0x05);
+            bm_base = bar & 0xfffc;
+            printk("hd: bus-master DMA at %04x\n\r", bm_base);
+            return;
+        }
+}
+
+/**
+ * @brief 探测驱动器，根据 IDENTIFY 数据确定寻址方式、容量和多扇区模式每组的扇区数。
+ * @details 第 49 字 bit 9 表示支持 LBA，第 60、61 字是 LBA28 可寻址的扇区总数；
+ * 第 1、3、6 字是默认的柱面数、磁头数、每磁道扇区数，BIOS 没有提供该驱动器参数时使用。
+ * 第 47 字低 8 位是 READ/WRITE MULTIPLE 支持的最大扇区数，取不超过它和 MAX_MULT 的最大 2 的幂。
+ * 第 49 字 bit 8 表示支持 DMA，找到了总线主控控制器时该驱动器的读写请求改走 DMA。
+ * 真正的 SET MULTIPLE MODE 在复位硬盘之后由 do_hd_request 发出。
+ */
+static void hd_probe(void)
+{
+    unsigned short id[256];
+    int drive, max;
+
+    hd_dma_probe();
+    outb_p(HD_CTL_NIEN, HD_CMD);
+    for (drive = 0; drive < MAX_HD && drive < sizeof(hd_info) / sizeof(struct hd_i_struct); drive++)
+    {
+        hd_info[drive].mult = 0;
+        hd_info[drive].lba_sects = 0;
+        hd_info[drive].dma = 0;
+        if (hd_identify(drive, id))
+            continue;
+        hd_info[drive].dma = bm_base && (id[49] & 0x100);
+        if (id[49] & 0x200)
+            hd_info[drive].lba_sects = id[60] | ((unsigned long) id[61] << 16);
+        if (!hd_info[drive].sect)   ///< HD_TYPE 没有指定，先用驱动器自己的几何参数，sys_setup 中 BIOS 有的话会覆盖
+        {
+            hd_info[drive].cyl = id[1];
+            hd_info[drive].head = id[3];
+            hd_info[drive].sect = id[6];
+            hd_info[drive].ctl = (id[3] > 8) ? 8 : 0;
+        }
+        max = id[47] & 0xff;
+        if (max > MAX_MULT)
+            max = MAX_MULT;
+        for (hd_info[drive].mult = 1; (hd_info[drive].mult << 1) <= max; hd_info[drive].mult <<= 1)
+            /* nothing */ ;
+    }
+    outb_p(0, HD_CMD);
+}
+
+/* 设置硬盘中断函数，探测驱动器，清除对主硬盘中断的屏蔽 */
 void hd_init(void)
 {
     blk_dev[MAJOR_NR].request_fn = DEVICE_REQUEST;		///< MAJOR_NR = 3 , request_fn = do_hd_request
+    hd_probe();                                         ///< 中断还没打开，以轮询方式读取驱动器识别数据
     set_intr_gate(0x2E, &hd_interrupt);                 ///< 设置硬盘中断处理函数。
     outb_p(inb_p(0x21)&0xfb,0x21);                      ///< 0x21:8259A控制寄存器的数据端口，0xfb=0b1111_1011，清除IRQ2的屏蔽位（级联到从片）。
     outb(inb_p(0xA1)&0xbf,0xA1);                        ///< 0xA1为从8259A芯片的数据端口，0xf=0b1011_1111，清除从片的IRQ14。
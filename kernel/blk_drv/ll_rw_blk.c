@@ -8,6 +8,7 @@
  * This handles all read/write requests to block devices
  */
 #include <errno.h>
+#include <linux/config.h>
 #include <linux/sched.h>
 #include <linux/kernel.h>
 #include <asm/system.h>
@@ -30,13 +31,13 @@ struct task_struct * wait_for_request = NULL;
  */
 struct blk_dev_struct blk_dev[NR_BLK_DEV] = 
 {
-    { NULL, NULL },        /* no_dev */
-    { NULL, NULL },        /* dev mem */
-    { NULL, NULL },        /* 软盘 fd (floopy disk) */
-    { NULL, NULL },        /* 硬盘 hd (hard disk)，do_hd_request */
-    { NULL, NULL },        /* dev ttyx */
-    { NULL, NULL },        /* dev tty */
-    { NULL, NULL }         /* dev lp */
+    { NULL, NULL, NULL },        /* no_dev */
+    { NULL, NULL, NULL },        /* dev mem */
+    { NULL, NULL, NULL },        /* 软盘 fd (floopy disk) */
+    { NULL, NULL, NULL },        /* 硬盘 hd (hard disk)，do_hd_request */
+    { NULL, NULL, NULL },        /* dev ttyx */
+    { NULL, NULL, NULL },        /* dev tty */
+    { NULL, NULL, NULL }         /* dev lp */
 };
 
 /* 锁定 buffer，多进程只有一个能锁定成功，其他进程会等待在 b_wait 上。*/
@@ -57,18 +58,85 @@ static inline void unlock_buffer(struct buffer_head * bh)
     wake_up(&bh->b_wait);
 }
 
+/*
+ * C-LOOK 单向电梯：磁头只朝扇区号增大的方向扫描，扫到最大的请求后跳回最小的请求重新开始。
+ * 以队列头（正在处理的请求）的位置 pos 为界，CLOOK_BEFORE 判断 a 是否应该排在 b 前面：
+ * 不小于 pos 的请求属于本轮扫描，排在小于 pos 的（下一轮）前面；同一轮内按位置升序。
+ * 远处的扇区最多等一轮扫描，不会被源源不断的近处请求饿死。
+ */
+#define CLOOK_BEFORE(pos, a, b) \
+( IN_ORDER(a, pos) == IN_ORDER(b, pos) ? IN_ORDER(a, b) : IN_ORDER(b, pos) )
+
+static void clook_add_request(struct blk_dev_struct * dev, struct request * req)
+{
+    struct request * pos = dev->current_request;
+    struct request * tmp;
+
+    for (tmp = pos ; tmp->next ; tmp = tmp->next)
+        if (CLOOK_BEFORE(pos, req, tmp->next))
+            break;
+    req->next = tmp->next;
+    tmp->next = req;
+}
+
+static struct request * clook_next_request(struct blk_dev_struct * dev, struct request * done)
+{
+    return done->next;
+}
+
+struct iosched_ops clook_iosched = {
+    "c-look", clook_add_request, clook_next_request
+};
+
+/*
+ * deadline：队列仍按 C-LOOK 排序，但每个请求入队时记下过期时刻（读 READ_EXPIRE，写 WRITE_EXPIRE）。
+ * 一个请求处理完时，如果队列里有已过期的请求，就先处理最早过期的那个，并把电梯的扫描起点转到它的位置，
+ * 这样大批写回进行时，交互式的读请求最多等待约 READ_EXPIRE。
+ */
+static void deadline_add_request(struct blk_dev_struct * dev, struct request * req)
+{
+    req->deadline = jiffies + (req->cmd == READ ? READ_EXPIRE : WRITE_EXPIRE);
+    clook_add_request(dev, req);
+}
+
+static struct request * deadline_next_request(struct blk_dev_struct * dev, struct request * done)
+{
+    struct request * first, * oldest, * last, * tmp;
+
+    if (!(first = done->next))
+        return NULL;
+    oldest = last = first;
+    for (tmp = first->next ; tmp ; tmp = tmp->next)     ///< 队列最多 NR_REQUEST 个请求
+    {
+        if (tmp->deadline < oldest->deadline)
+            oldest = tmp;
+        last = tmp;
+    }
+    if (oldest == first || oldest->deadline > jiffies)
+        return first;
+
+    /// 队列是一个从某处断开的环形升序序列，从 oldest 处断开再接回去，就得到以 oldest 为起点的 C-LOOK 顺序
+    for (tmp = first ; tmp->next != oldest ; tmp = tmp->next)
+        /* nothing */;
+    tmp->next = NULL;
+    last->next = first;
+    return oldest;
+}
+
+struct iosched_ops deadline_iosched = {
+    "deadline", deadline_add_request, deadline_next_request
+};
+
 /**
  * @brief 将硬盘请求加入到队列
  */
 static void add_request(struct blk_dev_struct * dev, struct request * req)
 {
-    struct request * tmp;
-
     req->next = NULL;
     cli();
     if (req->bh)                            ///< buffer_head 不空
         req->bh->b_dirt = 0;
-    if (!(tmp = dev->current_request))      ///< 如果没有请求，设置请求为当前请求
+    if (!dev->current_request)              ///< 如果没有请求，设置请求为当前请求
     {
         dev->current_request = req;
         sti();
@@ -76,15 +144,50 @@ static void add_request(struct blk_dev_struct * dev, struct request * req)
         return;
     }
 
-    /// 如果队列不为空，则将当前请求按照 IN_ORDER 排序加入 blk_dev 磁盘请求队列。
-    for ( ; tmp->next ; tmp = tmp->next)
-        if ((IN_ORDER(tmp, req) || !IN_ORDER(tmp, tmp->next)) && IN_ORDER(req, tmp->next))
-            break;
-    req->next=tmp->next;
-    tmp->next=req;
+    /// 如果队列不为空，则由设备的 IO 调度器决定当前请求在 blk_dev 磁盘请求队列中的位置。
+    (dev->iosched->add_request)(dev, req);
     sti();
 }
 
+/**
+ * @brief 尝试把 bh 合并进队列中已有的、同设备同命令且扇区相邻的请求。
+ * @return 1 合并成功，bh 已挂到请求的缓冲块链上；0 没有可合并的请求。
+ * @note 调用者必须已经关中断。队列头是驱动正在处理的请求，命令已经发给控制器，不能再扩展，所以从第二个开始找。
+ */
+static int attempt_merge(struct blk_dev_struct * dev, int rw, struct buffer_head * bh)
+{
+    struct request * req;
+    unsigned long sector = bh->b_blocknr << 1;
+
+    if (!(req = dev->current_request))
+        return 0;
+    while (req = req->next)
+    {
+        if (req->dev != bh->b_dev || req->cmd != rw || req->nr_sectors + 2 > MAX_SECTORS)
+            continue;
+        if (req->sector + req->nr_sectors == sector)        ///< 紧跟在请求之后，挂到链尾
+        {
+            req->bhtail->b_reqnext = bh;
+            req->bhtail = bh;
+        }
+        else if (req->sector == sector + 2)                 ///< 紧挨在请求之前，挂到链头
+        {
+            bh->b_reqnext = req->bh;
+            req->bh = bh;
+            req->buffer = bh->b_data;
+            req->sector = sector;
+            req->current_nr_sectors = 2;
+        }
+        else
+            continue;
+        req->nr_sectors += 2;
+        if (rw == WRITE)
+            bh->b_dirt = 0;                 ///< 与 add_request 一致，入队即视为已写回
+        return 1;
+    }
+    return 0;
+}
+
 /**
  * @brief 将请求加入到 blk_dev 的请求队列中，major 为硬盘主设备号（0x0300 的主设备号为 3）
  */
@@ -121,7 +224,16 @@ static void make_request(int major,int rw, struct buffer_head * bh)        ///<
         return;
     }
 
+    bh->b_reqnext = NULL;
 repeat:
+    /// 能和已有请求合并就不再占用新的请求项，相邻块会在一条硬盘命令里传输
+    cli();
+    if (attempt_merge(major + blk_dev, rw, bh))
+    {
+        sti();
+        return;
+    }
+    sti();
 /* we don't allow the write-requests to fill up the queue completely:
  * we want some room for reads: they take precedence. The last third            ///< 前 2/3 作为写请求
  * of the requests are only for reads.          ///< 后 1/3 作为读请求
@@ -151,9 +263,11 @@ repeat:
     req->errors = 0;
     req->sector = bh->b_blocknr<<1;             ///< 1 个内核块 = 2 个磁盘扇区
     req->nr_sectors = 2;
+    req->current_nr_sectors = 2;
     req->buffer = bh->b_data;                   ///< 内核块的位置
     req->waiting = NULL;
     req->bh = bh;
+    req->bhtail = bh;
     req->next = NULL;
     add_request(major + blk_dev, req);          ///< 将当前读写请求加入队列，major = 0b0011
 }
@@ -181,4 +295,10 @@ void blk_dev_init(void)
         request[i].dev = -1;                                        ///< 初始化读写请求的设备号为 -1
         request[i].next = NULL;
     }
+    for (i=0 ; i<NR_BLK_DEV ; i++)                                  ///< 按 config.h 选择启动时的 IO 调度器
+#ifdef IOSCHED_CLOOK
+        blk_dev[i].iosched = &clook_iosched;
+#else
+        blk_dev[i].iosched = &deadline_iosched;
+#endif
 }
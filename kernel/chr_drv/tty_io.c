@@ -125,8 +125,10 @@ void tty_intr(struct tty_struct * tty, int mask)
 	if (tty->pgrp <= 0)
 		return;
 	for (i=0;i<NR_TASKS;i++)
-		if (task[i] && task[i]->pgrp==tty->pgrp)
+		if (task[i] && task[i]->pgrp==tty->pgrp) {
 			task[i]->signal |= mask;
+			signal_wake_up(task[i]);
+		}
 }
 
 static void sleep_if_empty(struct tty_queue * queue)
@@ -240,11 +242,14 @@ void copy_to_cooked(struct tty_struct * tty)
 	wake_up(&tty->secondary.proc_list);
 }
 
+/* tty_read/tty_write 经过这么大的内核缓冲区成块地和用户空间交换数据 */
+#define TTY_CHUNK 64
+
 int tty_read(unsigned channel, char * buf, int nr)
 {
 	struct tty_struct * tty;
-	char c, * b=buf;
-	int minimum,time,flag=0;
+	char c, * b=buf, kbuf[TTY_CHUNK];
+	int minimum,time,flag=0,n;
 	long oldalarm;
 
 	if (channel>2 || nr<0) return -1;
@@ -255,7 +260,7 @@ int tty_read(unsigned channel, char * buf, int nr)
 	if (time && !minimum) {
 		minimum=1;
 		if (flag=(!oldalarm || time+jiffies<oldalarm))
-			current->alarm = time+jiffies;
+			set_alarm(time+jiffies);
 	}
 	if (minimum>nr)
 		minimum=nr;
@@ -271,30 +276,39 @@ int tty_read(unsigned channel, char * buf, int nr)
 			sleep_if_empty(&tty->secondary);
 			continue;
 		}
+		n = 0;
 		do {
 			GETCH(tty->secondary,c);
 			if (c==EOF_CHAR(tty) || c==10)
 				tty->secondary.data--;
-			if (c==EOF_CHAR(tty) && L_CANON(tty))
-				return (b-buf);
-			else {
-				put_fs_byte(c,b++);
+			if (c==EOF_CHAR(tty) && L_CANON(tty)) {
+				memcpy_tofs(b,kbuf,n);
+				return (b+n-buf);
+			} else {
+				kbuf[n++] = c;
+				if (n == TTY_CHUNK) {
+					memcpy_tofs(b,kbuf,n);
+					b += n;
+					n = 0;
+				}
 				if (!--nr)
 					break;
 			}
 		} while (nr>0 && !EMPTY(tty->secondary));
+		memcpy_tofs(b,kbuf,n);
+		b += n;
 		if (time && !L_CANON(tty))
 			if (flag=(!oldalarm || time+jiffies<oldalarm))
-				current->alarm = time+jiffies;
+				set_alarm(time+jiffies);
 			else
-				current->alarm = oldalarm;
+				set_alarm(oldalarm);
 		if (L_CANON(tty)) {
 			if (b-buf)
 				break;
 		} else if (b-buf >= minimum)
 			break;
 	}
-	current->alarm = oldalarm;
+	set_alarm(oldalarm);
 	if (current->signal && !(b-buf))
 		return -EINTR;
 	return (b-buf);
@@ -304,7 +318,8 @@ int tty_write(unsigned channel, char * buf, int nr)		///< channel = 0
 {
 	static cr_flag = 0;
 	struct tty_struct * tty;
-	char c, *b = buf;
+	char c, *b = buf, kbuf[TTY_CHUNK], *k;
+	int left;
 
 	if (channel > 2 || nr < 0)
 		return -1;
@@ -314,9 +329,16 @@ int tty_write(unsigned channel, char * buf, int nr)		///< channel = 0
 		sleep_if_full(&tty->write_q);					///< 写入队列满了则睡眠在这里。
 		if (current->signal)							///< 若有信号位图，则停止输出。
 			break;
+		left = 0;
 		while (nr > 0 && !FULL(tty->write_q)) 
 		{
-			c = get_fs_byte(b);							///< 获取 1 字节。
+			if (!left)									///< 一次从用户空间取一块
+			{
+				left = (nr < TTY_CHUNK) ? nr : TTY_CHUNK;
+				memcpy_fromfs(kbuf, b, left);
+				k = kbuf;
+			}
+			c = *k;										///< 获取 1 字节。
 			if (O_POST(tty)) 							///< 判断是否包含输出处理（如 NL->CR/NL 转换，回车->换行/回车）
 			{
 				if (c == '\r' && O_CRNL(tty))			///< 回车转换行
@@ -333,6 +355,8 @@ int tty_write(unsigned channel, char * buf, int nr)		///< channel = 0
 					c = toupper(c);
 			}
 			b++;
+			k++;
+			left--;
 			nr--;
 			cr_flag = 0;
 			PUTCH(c, tty->write_q);
@@ -36,7 +36,13 @@ void verify_area(void * addr,int size)
 	}
 }
 
-int copy_mem(int nr,struct task_struct * p)
+/*
+ * 子进程有自己的页目录，用户空间和父进程一样从 TASK_BASE 开始（0 号进程 fork 1 号
+ * 进程时从线性地址 0 复制到 TASK_BASE）。
+ * vfork 时子进程沿用父进程的页目录（*p = *current 已经复制了 tss.cr3 和 LDT），
+ * 页表完全不复制，父进程在 copy_process 中等到子进程 exec 或 exit。
+ */
+int copy_mem(int nr,struct task_struct * p,int vfork)
 {
 	unsigned long old_data_base,new_data_base,data_limit;
 	unsigned long old_code_base,new_code_base,code_limit;
@@ -49,12 +55,18 @@ int copy_mem(int nr,struct task_struct * p)
 		panic("We don't support separate I&D");
 	if (data_limit < code_limit)
 		panic("Bad data_limit");
-	new_data_base = new_code_base = nr * 0x4000000;
+	if (vfork)
+		return 0;
+	if (!(p->tss.cr3 = new_page_dir()))
+		return -ENOMEM;
+	new_data_base = new_code_base = TASK_BASE;
 	p->start_code = new_code_base;
 	set_base(p->ldt[1],new_code_base);
 	set_base(p->ldt[2],new_data_base);
-	if (copy_page_tables(old_data_base,new_data_base,data_limit)) {
-		free_page_tables(new_data_base,data_limit);
+	if (copy_page_tables(current->tss.cr3,p->tss.cr3,
+	    old_data_base,new_data_base,data_limit)) {
+		free_page_tables(p->tss.cr3,new_data_base,data_limit);
+		free_page(p->tss.cr3);
 		return -ENOMEM;
 	}
 	return 0;
@@ -64,8 +76,11 @@ int copy_mem(int nr,struct task_struct * p)
  *  Ok, this is the main fork-routine. It copies the system process
  * information (task[nr]) and sets up the necessary registers. It
  * also copies the data segment in it's entirety.
+ *
+ * vfork 非 0 时（sys_vfork）子进程共享父进程的地址空间，父进程在这里睡眠，
+ * 直到子进程调用 vfork_release（exec 或 exit 时）。
  */
-int copy_process(int nr,long ebp,long edi,long esi,long gs,long none,
+int copy_process(int vfork,int nr,long ebp,long edi,long esi,long gs,long none,
 		long ebx,long ecx,long edx,
 		long fs,long es,long ds,
 		long eip,long cs,long eflags,long esp,long ss)
@@ -74,7 +89,7 @@ int copy_process(int nr,long ebp,long edi,long esi,long gs,long none,
 	int i;
 	struct file *f;
 
-	p = (struct task_struct *) get_free_page();
+	p = (struct task_struct *) __get_free_page(0);	/* 下面会复制整个 task_struct，其余是内核栈 */
 	if (!p)
 		return -EAGAIN;
 	task[nr] = p;
@@ -83,8 +98,11 @@ int copy_process(int nr,long ebp,long edi,long esi,long gs,long none,
 	p->pid = last_pid;
 	p->father = current->pid;
 	p->counter = p->priority;
+	p->run_level = -1;	/* 不在运行队列上 */
 	p->signal = 0;
 	p->alarm = 0;
+	p->alarm_timer.next = NULL;	/* 闹钟不继承 */
+	p->alarm_timer.pprev = NULL;
 	p->leader = 0;		/* process leadership doesn't inherit */
 	p->utime = p->stime = 0;
 	p->cutime = p->cstime = 0;
@@ -110,9 +128,10 @@ int copy_process(int nr,long ebp,long edi,long esi,long gs,long none,
 	p->tss.gs = gs & 0xffff;
 	p->tss.ldt = _LDT(nr);
 	p->tss.trace_bitmap = 0x80000000;
+	p->vfork_parent = vfork ? current : NULL;
 	if (last_task_used_math == current)
 		__asm__("clts ; fnsave %0"::"m" (p->tss.i387));
-	if (copy_mem(nr,p)) {
+	if (copy_mem(nr,p,vfork)) {
 		task[nr] = NULL;
 		free_page((long) p);
 		return -EAGAIN;
@@ -126,10 +145,44 @@ int copy_process(int nr,long ebp,long edi,long esi,long gs,long none,
 		current->root->i_count++;
 	if (current->executable)
 		current->executable->i_count++;
+	for (i=0; i<NR_MMAP; i++)
+		if (p->mmap[i].vm_inode)
+			p->mmap[i].vm_inode->i_count++;
 	set_tss_desc(gdt+(nr<<1)+FIRST_TSS_ENTRY,&(p->tss));
 	set_ldt_desc(gdt+(nr<<1)+FIRST_LDT_ENTRY,&(p->ldt));
-	p->state = TASK_RUNNING;	/* do this last, just in case */
-	return last_pid;
+	wake_up_process(p);	/* do this last, just in case */
+	i = p->pid;
+	while (p->vfork_parent == current) {
+		current->state = TASK_UNINTERRUPTIBLE;
+		schedule();
+	}
+	return i;
+}
+
+/*
+ * vfork 出来的子进程在 exec 的不归点之前或者 exit 时调用：换到自己的页目录
+ * （用户部分还是空的），不再碰父进程的页表，然后唤醒父进程。
+ * 没有内存分配页目录时 exec 返回 -ENOMEM（还在父进程的地址空间里）；exit 时
+ * 换到 pg_dir，它在 TASK_BASE 以上是空的，之后释放页表什么也不会做。
+ */
+int vfork_release(int exiting)
+{
+	struct task_struct * parent;
+	unsigned long dir;
+
+	if (!(parent = current->vfork_parent))
+		return 0;
+	if (!(dir = new_page_dir())) {
+		if (!exiting)
+			return -ENOMEM;
+		dir = (unsigned long) pg_dir;
+	}
+	current->tss.cr3 = dir;
+	__asm__("movl %%eax,%%cr3"::"a" (dir));
+	current->vfork_parent = NULL;
+	if (parent->state == TASK_UNINTERRUPTIBLE)
+		wake_up_process(parent);
+	return 0;
 }
 
 int find_empty_process(void)
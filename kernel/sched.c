@@ -19,6 +19,8 @@
 #include <asm/segment.h>
 
 #include <signal.h>
+#include <errno.h>
+#include <time.h>
 
 #define _S(nr) (1<<((nr)-1))
 #define _BLOCKABLE (~(_S(SIGKILL) | _S(SIGSTOP)))
@@ -59,6 +61,7 @@ static union task_union init_task = {INIT_TASK,};
 
 long volatile jiffies = 0;  ///< 自系统启动以来经过的“时钟滴答”次数。
 long startup_time = 0;      ///< 系统开始时间，即 1970年1月1日 开始的秒数。
+long nr_switches = 0;       ///< 进程切换次数，统计用。
 struct task_struct *current = &(init_task.task);    ///< 当前进程指针
 struct task_struct *last_task_used_math = NULL;
 
@@ -91,56 +94,170 @@ void math_state_restore()
     }
 }
 
-/**
- * @brief 进行进程切换。
- * @details 检测闹钟和其他信号，选择时间片最多的进程进行切换（都没有时间片则依照优先级进行重新分配时间片）。
+/*
+ * 运行队列：每个可运行进程（0 号任务除外）按剩余时间片 counter 挂在某一级队列上，
+ * 每级一个循环双向链表，位图记录哪些级非空，schedule 用 bsrl 直接找到时间片最多的
+ * 那一级。队列分 active/expired 两组：时间片用完的进程马上按 priority 重新分配时间片
+ * 放进 expired，active 空了就交换两组，代替原来给所有进程重算 counter 的遍历。
+ *
+ * 进程只会自己把自己从 TASK_RUNNING 改成睡眠（或僵死），所以 schedule 里对 current
+ * 重新入队即可；别的进程变成 TASK_RUNNING 都要经过 wake_up_process。中断里也会
+ * 唤醒进程，所以队列操作都要关中断。
  */
-void schedule(void)
+#define NR_RUN_LEVELS 64
+
+static struct task_struct * run_queue[2*NR_RUN_LEVELS];
+static unsigned long run_bitmap[2*NR_RUN_LEVELS/32];
+static int run_active = 0;          ///< active 组的起始下标，0 或 NR_RUN_LEVELS
+
+static inline int last_bit(unsigned long word)
 {
-    int i,next,c;
-    struct task_struct ** p;
+    int bit;
 
-/* check alarm, wake up any interruptible tasks that have got a signal */
+    __asm__("bsrl %1,%0":"=r" (bit):"rm" (word));
+    return bit;
+}
 
-    for(p = &LAST_TASK ; p > &FIRST_TASK ; --p)
-        if (*p) 
-        {
-            if ((*p)->alarm && (*p)->alarm < jiffies) { ///< 如果有闹钟 && 闹钟到时间了。
-                (*p)->signal |= (1<<(SIGALRM-1));       ///< 加入时钟中断
-                (*p)->alarm = 0;
-            }
-            if (((*p)->signal & ~(_BLOCKABLE & (*p)->blocked)) &&   /* 进程可被中断 && 有未被屏蔽信号 */
-            (*p)->state==TASK_INTERRUPTIBLE)
-                (*p)->state=TASK_RUNNING;               /* 让它去争抢时间片 */
-        }
+static void enqueue_task(struct task_struct * p)
+{
+    struct task_struct ** head;
+    int idx;
+
+    if (p->counter <= 0) {                  ///< 时间片用完，重新分配后放到 expired 组
+        p->counter = p->priority;
+        idx = run_active ^ NR_RUN_LEVELS;
+    } else
+        idx = run_active;
+    idx += (p->counter < NR_RUN_LEVELS) ? p->counter : NR_RUN_LEVELS-1;
+    head = run_queue + idx;
+    if (*head) {                            ///< 挂到队尾，同一级的进程轮流运行
+        p->run_next = *head;
+        p->run_prev = (*head)->run_prev;
+        p->run_prev->run_next = p;
+        (*head)->run_prev = p;
+    } else {
+        *head = p->run_next = p->run_prev = p;
+        run_bitmap[idx>>5] |= 1 << (idx&31);
+    }
+    p->run_level = idx;
+}
 
-/* this is the scheduler proper: */
+static void dequeue_task(struct task_struct * p)
+{
+    int idx = p->run_level;
 
-    while (1)
-    {
-        c = -1;
-        next = 0;
-        i = NR_TASKS;
-        p = &task[NR_TASKS];
-        while (--i) {
-            if (!*--p)      /* 判断任务是否存在，不存在则继续 */
-                continue;
-            if ((*p)->state == TASK_RUNNING && (*p)->counter > c)   /* 寻找时间片最多的任务 */
-                c = (*p)->counter, next = i;
-        }
-        if (c) break;
-        for(p = &LAST_TASK ; p > &FIRST_TASK ; --p) /* 如果时间片都没有了，那么根据优先级重新分配时间片 */
-            if (*p)
-                (*p)->counter = ((*p)->counter >> 1) +
-                        (*p)->priority;
+    if (p->run_next == p) {
+        run_queue[idx] = NULL;
+        run_bitmap[idx>>5] &= ~(1 << (idx&31));
+    } else {
+        p->run_next->run_prev = p->run_prev;
+        p->run_prev->run_next = p->run_next;
+        if (run_queue[idx] == p)
+            run_queue[idx] = p->run_next;
+    }
+    p->run_level = -1;
+}
+
+/* 取时间片最多的可运行进程，active 组空了就和 expired 组交换，都空了就运行 0 号任务 */
+static struct task_struct * pick_next_task(void)
+{
+    unsigned long * map = run_bitmap + (run_active>>5);
+
+    if (!map[0] && !map[1]) {
+        run_active ^= NR_RUN_LEVELS;
+        map = run_bitmap + (run_active>>5);
+        if (!map[0] && !map[1])
+            return task[0];
+    }
+    if (map[1])
+        return run_queue[run_active + 32 + last_bit(map[1])];
+    return run_queue[run_active + last_bit(map[0])];
+}
+
+/* 让进程 p 进入 TASK_RUNNING，不在运行队列上的话挂上去 */
+void wake_up_process(struct task_struct * p)
+{
+    unsigned long flags;
+
+    save_flags(flags);
+    cli();
+    p->state = TASK_RUNNING;
+    if (p->run_level < 0 && p != task[0])
+        enqueue_task(p);
+    restore_flags(flags);
+}
+
+/* 给 p 发了信号之后调用：可中断睡眠中的进程有未屏蔽的信号就唤醒它 */
+void signal_wake_up(struct task_struct * p)
+{
+    if (p->state == TASK_INTERRUPTIBLE &&
+        (p->signal & ~(_BLOCKABLE & p->blocked)))
+        wake_up_process(p);
+}
+
+/* 闹钟定时器到期：给进程发 SIGALRM */
+static void alarm_timeout(unsigned long data)
+{
+    struct task_struct * p = (struct task_struct *) data;
+
+    p->signal |= (1<<(SIGALRM-1));
+    p->alarm = 0;
+    signal_wake_up(p);
+}
+
+/* 设置当前进程的闹钟，expires 是 jiffies 时间，0 表示取消 */
+void set_alarm(long expires)
+{
+    current->alarm = expires;
+    if (!expires) {
+        del_timer(&current->alarm_timer);
+        return;
+    }
+    current->alarm_timer.expires = expires;
+    current->alarm_timer.data = (unsigned long) current;
+    current->alarm_timer.fn = alarm_timeout;
+    add_timer(&current->alarm_timer);
+}
+
+/**
+ * @brief 进行进程切换。
+ * @details 把 current 按剩余时间片重新入队（不再可运行就移出队列），然后从运行队列里
+ * 取时间片最多的进程切换过去，开销和进程数无关。
+ */
+void schedule(void)
+{
+    struct task_struct * next;
+    unsigned long flags;
+
+    save_flags(flags);
+    cli();
+    if (current != task[0]) {
+        /* 睡眠前已经有未屏蔽的信号，不用睡了 */
+        if (current->state == TASK_INTERRUPTIBLE &&
+            (current->signal & ~(_BLOCKABLE & current->blocked)))
+            current->state = TASK_RUNNING;
+        if (current->run_level >= 0)
+            dequeue_task(current);
+        if (current->state == TASK_RUNNING)
+            enqueue_task(current);
     }
-    switch_to(next);    ///< 跳转到进程 next。
+    next = pick_next_task();
+    restore_flags(flags);
+    if (next != current)
+        nr_switches++;
+    switch_to(TASK_NR(next));    ///< 跳转到进程 next。
 }
 
+static void cpu_idle(void);
+
 int sys_pause(void)
 {
+    if (current == task[0])         ///< 0 号任务只在空闲时运行，顺便预先清零一些空闲页
+        refill_zero_pages();
     current->state = TASK_INTERRUPTIBLE;
     schedule();
+    if (current == task[0])         ///< 还是没有别的进程可运行，停机等中断
+        cpu_idle();
     return 0;
 }
 
@@ -161,7 +278,7 @@ void sleep_on(struct task_struct **p)
     current->state = TASK_UNINTERRUPTIBLE;  ///< 当前进程不可中断的状态，将自己阻塞，让其他进程去争抢时间片。只能由 wakeup 唤醒。
     schedule();
     if (tmp)                                ///< 时间片轮转到此进程时，继续在此处执行。
-        tmp->state = 0;                     ///< 激活自己的上一个等待进程，让上一个进程去争抢轮询时间片。
+        wake_up_process(tmp);               ///< 激活自己的上一个等待进程，让上一个进程去争抢轮询时间片。
 }
 
 /**
@@ -184,12 +301,77 @@ repeat:
     if (*p && *p != current)        ///< current 是当前正在运行的进程，进入 schedule 后，进程切换，current 变为其他进程，但是当走下 schedule 后，current 又切换为当前进程。
     {                               ///< *p != current，说明在 current 不在队列头，在它之上还有等待进程，这里是处理竞态，因为被唤醒了，一般说明自己是队列头，但是却又发现头不是自己，说明在这期间有其他进程又sleep到这个队列上了
                                     ///< 所以这里发现了这个现象后，让自己睡眠，让队列头部进程运行。
-        (**p).state = 0;            ///< 让头部等待进程进入可被调度的状态。
+        wake_up_process(*p);        ///< 让头部等待进程进入可被调度的状态。
         goto repeat;                ///< 重新让当前进程睡眠。
     }
     *p = NULL;                      ///< 这里需要自己清空队列，因为 interruptible_sleep_on 可能并不是由 wake_up 唤醒的（wake_up 会清理队列），可能是由信号等。
     if (tmp)
-        tmp->state = 0;             ///< 激活自己的上一个等待进程，让上一个进程去争抢轮询时间片。
+        wake_up_process(tmp);       ///< 激活自己的上一个等待进程，让上一个进程去争抢轮询时间片。
+}
+
+/* 睡眠超时的定时器：唤醒睡眠的进程 */
+static void process_timeout(unsigned long data)
+{
+    wake_up_process((struct task_struct *) data);
+}
+
+/*
+ * 带超时的睡眠，state 为 TASK_UNINTERRUPTIBLE 或 TASK_INTERRUPTIBLE。
+ * 定时器放在自己的内核栈上，返回前一定摘掉。和 interruptible_sleep_on 一样，
+ * 醒来时发现队首不是自己（之后又有进程睡下来），就先唤醒队首接着睡，
+ * 等自己成为队首再离开，这样队列里的 tmp 链不会断。定时器已经到期就不再睡了。
+ * 状态要在挂定时器之前改好：否则定时器在两步之间到期，唤醒的是一个还在运行的进程，
+ * 之后它睡下去就再也没有人叫醒。
+ * 返回还剩多少个滴答没睡完，超时返回 0。
+ */
+static long __sleep_on_timeout(struct task_struct **p, long timeout, int state)
+{
+    struct task_struct *tmp;
+    struct timer_list timer;
+    unsigned long flags;
+
+    if (!p || timeout <= 0)
+        return 0;
+    if (current == &(init_task.task))
+        panic("task[0] trying to sleep");
+    timer.next = NULL;
+    timer.pprev = NULL;
+    timer.expires = jiffies + timeout;
+    timer.data = (unsigned long) current;
+    timer.fn = process_timeout;
+    current->state = state;
+    add_timer(&timer);
+    tmp = *p;
+    *p = current;
+    schedule();
+    while (*p && *p != current) {
+        wake_up_process(*p);
+        save_flags(flags);
+        cli();
+        if (!timer_pending(&timer)) {       ///< 已经超时
+            restore_flags(flags);
+            break;
+        }
+        current->state = state;
+        restore_flags(flags);
+        schedule();
+    }
+    *p = NULL;
+    if (tmp)
+        wake_up_process(tmp);
+    del_timer(&timer);
+    timeout = timer.expires - jiffies;
+    return (timeout > 0) ? timeout : 0;
+}
+
+long sleep_on_timeout(struct task_struct **p, long timeout)
+{
+    return __sleep_on_timeout(p, timeout, TASK_UNINTERRUPTIBLE);
+}
+
+long interruptible_sleep_on_timeout(struct task_struct **p, long timeout)
+{
+    return __sleep_on_timeout(p, timeout, TASK_INTERRUPTIBLE);
 }
 
 /* 唤醒等待进程，让进程可以争抢时间片 */
@@ -197,7 +379,7 @@ void wake_up(struct task_struct **p)
 {
     if (p && *p) 
     {
-        (**p).state = 0;///< 更新当前进程的状态，0 为 TASK_RUNNING，可以争抢时间片了
+        wake_up_process(*p);///< 更新当前进程的状态为 TASK_RUNNING 并放入运行队列，可以争抢时间片了
         *p = NULL;      ///< 将队列头置空，因为队列头变为 TASK_RUNNING 后会激活队列头的下一个等待进程。
                         ///< 下一个等待进程进入调度后也是如此，因此就激活了所有的等待进程，详见 sleep_on 函数。
     }
@@ -274,44 +456,324 @@ void do_floppy_timer(void)
     }
 }
 
-#define TIME_REQUESTS 64
+/*
+ * 分层时间轮：tv1 有 256 个槽，每槽对应一个滴答；tvn[0..3] 各 64 个槽，每槽分别对应
+ * 2^8、2^14、2^20、2^26 个滴答。定时器按距离到期的时间挂进对应的槽，插入和删除都是
+ * O(1)。timer_jiffies 是时间轮已经处理到的时刻，tv1 转完一圈时把 tvn[0] 的下一个
+ * 槽重新分散到 tv1，依此类推（cascade），每个定时器最多被搬动 4 次。
+ */
+#define TVN_BITS 6
+#define TVR_BITS 8
+#define TVN_SIZE (1 << TVN_BITS)
+#define TVR_SIZE (1 << TVR_BITS)
+#define TVN_MASK (TVN_SIZE - 1)
+#define TVR_MASK (TVR_SIZE - 1)
+
+static struct timer_list * tv1[TVR_SIZE];
+static struct timer_list * tvn[4][TVN_SIZE];
+static unsigned long timer_jiffies = 0;
+
+static void internal_add_timer(struct timer_list * timer)
+{
+    unsigned long expires = timer->expires;
+    unsigned long idx = expires - timer_jiffies;
+    struct timer_list ** vec;
+
+    if ((long) idx < 0)                     ///< 已经过期，下一个滴答处理
+        vec = tv1 + (timer_jiffies & TVR_MASK);
+    else if (idx < TVR_SIZE)
+        vec = tv1 + (expires & TVR_MASK);
+    else if (idx < 1 << (TVR_BITS + TVN_BITS))
+        vec = tvn[0] + ((expires >> TVR_BITS) & TVN_MASK);
+    else if (idx < 1 << (TVR_BITS + 2*TVN_BITS))
+        vec = tvn[1] + ((expires >> (TVR_BITS + TVN_BITS)) & TVN_MASK);
+    else if (idx < 1 << (TVR_BITS + 3*TVN_BITS))
+        vec = tvn[2] + ((expires >> (TVR_BITS + 2*TVN_BITS)) & TVN_MASK);
+    else
+        vec = tvn[3] + ((expires >> (TVR_BITS + 3*TVN_BITS)) & TVN_MASK);
+    if (timer->next = *vec)
+        (*vec)->pprev = &timer->next;
+    *vec = timer;
+    timer->pprev = vec;
+}
+
+static inline void detach_timer(struct timer_list * timer)
+{
+    if (timer->next)
+        timer->next->pprev = timer->pprev;
+    *timer->pprev = timer->next;
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/* 挂上定时器，已经挂着的先摘下来（相当于修改到期时间） */
+void add_timer(struct timer_list * timer)
+{
+    unsigned long flags;
+
+    save_flags(flags);
+    cli();
+    if (timer->pprev)
+        detach_timer(timer);
+    internal_add_timer(timer);
+    restore_flags(flags);
+}
+
+/* 取消定时器，返回它是否还没到期 */
+int del_timer(struct timer_list * timer)
+{
+    unsigned long flags;
+    int ret = 0;
+
+    save_flags(flags);
+    cli();
+    if (timer->pprev) {
+        detach_timer(timer);
+        ret = 1;
+    }
+    restore_flags(flags);
+    return ret;
+}
+
+/* 把 tvn[n] 当前槽里的定时器重新分散到更低的层，返回槽号 */
+static int cascade(int n)
+{
+    int idx = (timer_jiffies >> (TVR_BITS + n*TVN_BITS)) & TVN_MASK;
+    struct timer_list * timer, * next;
+
+    timer = tvn[n][idx];
+    tvn[n][idx] = NULL;
+    for ( ; timer ; timer = next) {
+        next = timer->next;
+        internal_add_timer(timer);
+    }
+    return idx;
+}
 
-static struct timer_list {
-    long jiffies;
+/* 时钟中断里调用（中断关着）：处理到当前 jiffies 为止到期的定时器 */
+static void run_timer_list(void)
+{
+    struct timer_list * timer;
     void (*fn)();
-    struct timer_list * next;
-} timer_list[TIME_REQUESTS], * next_timer = NULL;
+    int idx, n;
+
+    while ((long) (jiffies - timer_jiffies) >= 0) {
+        idx = timer_jiffies & TVR_MASK;
+        if (!idx)
+            for (n = 0 ; n < 4 && !cascade(n) ; n++)
+                /* nothing */ ;
+        while (timer = tv1[idx]) {
+            detach_timer(timer);
+            fn = timer->fn;
+            fn(timer->data);
+        }
+        timer_jiffies++;
+    }
+}
+
+/* 读 PIT 通道 0 的当前计数（周期模式下从 LATCH 往下数到 1） */
+static unsigned int pit_count(void)
+{
+    unsigned int count;
+
+    outb_p(0x00, 0x43);                     /* 锁存通道 0 的计数 */
+    count = inb_p(0x40);
+    count |= inb(0x40) << 8;
+    return count;
+}
+
+/*
+ * 无滴答空闲：0 号任务发现没有可运行的进程时，把 PIT 改成单次触发（模式 0），
+ * 一直停机到时间轮上最近的定时器到期（闹钟也挂在时间轮上），中间不再有时钟中断；
+ * 醒来后把跳过的滴答补到 jiffies 上，再恢复成周期模式（模式 2）。
+ * PIT 计数器只有 16 位，一次最多跳过 0xffff/LATCH 个滴答（HZ=100 时是 5 个），
+ * HZ 越高能跳过的滴答越多。
+ * idle_ticks 不为 0 表示 PIT 处在单次模式，下一次时钟中断时 jiffies 应该加上 idle_ticks。
+ *
+ * 高精度睡眠（nanosleep 不足一个滴答的部分）也借用单次模式：hr_list 上挂着到期时刻
+ * 落在当前这个滴答之内的睡眠者，expires 是到期时在这个滴答里已经过去的计数。空闲时
+ * PIT 改成在最早的那个时刻中断（hr_armed），这次中断不算滴答；之后再单次数到滴答边界，
+ * 相位不变。CPU 忙的时候不改 PIT，下一个滴答把 hr_list 上的都唤醒，只会多睡不会少睡。
+ */
+#define PIT_MARGIN 100                      ///< 离下一个滴答太近（约 84us）就不改 PIT 了
+
+static unsigned long idle_ticks = 0;
+static unsigned long idle_count;            ///< 单次模式装入的计数
+static struct timer_list * hr_list = NULL;
+static int hr_armed = 0;                    ///< PIT 正在数到 hr_list 上的某个时刻，而不是滴答边界
+static unsigned long hr_rest;               ///< hr_armed 时，从那个时刻到滴答边界还有多少计数
+
+/* 到下一个滴答边界还剩多少计数（中断关着调用，PIT 没有在跳过滴答） */
+static unsigned long pit_left(void)
+{
+    unsigned long count = pit_count();
+
+    if (count > LATCH)                      ///< 单次计数已经数过 0，中断还没处理
+        count = 0;
+    return hr_armed ? count + hr_rest : count;
+}
+
+/* 时钟中断已经在 8259A 的 IRR 里等着，还没处理（中断关着调用） */
+static int timer_irq_pending(void)
+{
+    outb_p(0x0a, 0x20);                     /* OCW3：下一次读 IRR */
+    return inb_p(0x20) & 1;
+}
+
+/*
+ * 现在在 jiffies 这个滴答里已经过去多少计数（中断关着调用）。滴答边界刚过而时钟中断
+ * 还没处理时 jiffies 落后一个滴答，返回值会大于等于 LATCH。
+ */
+static unsigned long tick_elapsed(void)
+{
+    unsigned long left;
+    int pending;
+
+    do {
+        pending = timer_irq_pending();
+        left = pit_left();
+    } while (pending != timer_irq_pending());
+    if (pending && !hr_armed)
+        return idle_ticks ? LATCH : 2*LATCH - left;
+    return LATCH - left;
+}
+
+static void pit_oneshot(unsigned long count)
+{
+    outb_p(0x30, 0x43);                     /* binary, mode 0, LSB/MSB, ch 0 */
+    outb_p(count & 0xff, 0x40);
+    outb(count >> 8, 0x40);
+}
+
+/*
+ * 中断关着调用，left 是到滴答边界还剩的计数：唤醒已经到期的高精度睡眠者，
+ * 还有没到期的就让 PIT 在最早的那个时刻中断；刚处理完 hr 中断而没有剩下的，就数到滴答边界。
+ */
+static void hr_program(unsigned long left)
+{
+    struct timer_list * timer, * next, * first = NULL;
+
+    for (timer = hr_list ; timer ; timer = next) {
+        next = timer->next;
+        if (LATCH - timer->expires + PIT_MARGIN >= left) {
+            detach_timer(timer);
+            wake_up_process((struct task_struct *) timer->data);
+        } else if (!first || timer->expires < first->expires)
+            first = timer;
+    }
+    if (first) {
+        hr_rest = LATCH - first->expires;
+        hr_armed = 1;
+        idle_ticks = 1;
+        pit_oneshot(left - hr_rest);
+    } else if (hr_armed) {
+        hr_armed = 0;
+        idle_ticks = 1;
+        pit_oneshot(left ? left : 1);
+    }
+}
+
+/*
+ * 离最近的定时器到期还有几个滴答。tvn 里的定时器要等 tv1 转完一圈才 cascade 下来，
+ * 在那之前到期的定时器一定在 tv1 里，所以只扫到这一圈结束，找不到就在 cascade 时醒来。
+ */
+static unsigned long next_timer_ticks(void)
+{
+    int i = 0;
 
-void add_timer(long jiffies, void (*fn)(void))
+    do {
+        if (tv1[(timer_jiffies + i) & TVR_MASK])
+            break;
+    } while ((timer_jiffies + ++i) & TVR_MASK);
+    return timer_jiffies + i - jiffies;
+}
+
+/* PIT 恢复成周期模式，从现在起每 LATCH 个计数一个滴答 */
+static void pit_periodic(void)
 {
-    struct timer_list * p;
+    outb_p(0x34, 0x43);                     /* binary, mode 2, LSB/MSB, ch 0 */
+    outb_p(LATCH & 0xff, 0x40);
+    outb(LATCH >> 8, 0x40);
+}
 
-    if (!fn)
+/* 单次计数到了（在时钟中断里，中断关着）：补上跳过的滴答，恢复周期模式 */
+static void tick_resume(void)
+{
+    jiffies += idle_ticks - 1;              ///< 时钟中断已经加过 1 了
+    current->stime += idle_ticks - 1;
+    idle_ticks = 0;
+    pit_periodic();
+}
+
+/*
+ * 单次模式下被别的中断提前叫醒（中断关着）：把已经过去的整滴答补上，到下一个滴答
+ * 还剩的计数仍交给单次模式，那次时钟中断里由 tick_resume 恢复周期模式，滴答的相位不变。
+ * 计数正好是 LATCH 的整数倍时正在滴答边界上，这个滴答已经过去，直接恢复周期模式。
+ */
+static void tick_wakeup(void)
+{
+    unsigned int status, count;
+    unsigned long left;
+
+    outb_p(0xc2, 0x43);                     /* read-back：锁存通道 0 的状态和计数 */
+    status = inb_p(0x40);
+    count = inb_p(0x40);
+    count |= inb(0x40) << 8;
+    if (status & 0x80)                      ///< OUT 已变高，计数到了，时钟中断马上就来
+        return;
+    left = count / LATCH;                   ///< 下一个滴答之后还有几个整滴答
+    count %= LATCH;
+    if (left && !count) {
+        jiffies += idle_ticks - left;
+        current->stime += idle_ticks - left;
+        idle_ticks = 0;
+        pit_periodic();
         return;
+    }
+    jiffies += idle_ticks - 1 - left;
+    current->stime += idle_ticks - 1 - left;
+    idle_ticks = 1;
+    if (left) {
+        outb_p(0x30, 0x43);                 /* binary, mode 0, LSB/MSB, ch 0 */
+        outb_p(count & 0xff, 0x40);
+        outb(count >> 8, 0x40);
+    }
+}
+
+/* 0 号任务空闲时调用：没有可运行的进程就 hlt，能跳过滴答就先把 PIT 改成单次模式 */
+static void cpu_idle(void)
+{
+    extern int beepcount;
+    unsigned long ticks, count;
+
     cli();
-    if (jiffies <= 0)
-        (fn)();
+    if (timer_irq_pending())                ///< 时钟中断已经在等了，PIT 的计数和 jiffies 对不上，这次不改 PIT
+        ticks = 0;
     else {
-        for (p = timer_list ; p < timer_list + TIME_REQUESTS ; p++)
-            if (!p->fn)
-                break;
-        if (p >= timer_list + TIME_REQUESTS)
-            panic("No more time requests free");
-        p->fn = fn;
-        p->jiffies = jiffies;
-        p->next = next_timer;
-        next_timer = p;
-        while (p->next && p->next->jiffies < p->jiffies) {
-            p->jiffies -= p->next->jiffies;
-            fn = p->fn;
-            p->fn = p->next->fn;
-            p->next->fn = fn;
-            jiffies = p->jiffies;
-            p->jiffies = p->next->jiffies;
-            p->next->jiffies = jiffies;
-            p = p->next;
+        if (hr_list && (!hr_armed || pit_count() > PIT_MARGIN))    ///< 已经在数的 hr 中断马上就到就别改了
+            hr_program(pit_left());
+        ticks = next_timer_ticks();
+    }
+    if (run_bitmap[0] | run_bitmap[1] | run_bitmap[2] | run_bitmap[3]) {
+        sti();                              ///< 刚才的中断唤醒了进程
+        return;
+    }
+    if (!hr_list && !hr_armed && ticks > 1 && !beepcount && !(current_DOR & 0xf0)) {  ///< 蜂鸣器和软驱马达要每个滴答计时
+        count = pit_count();                ///< 到下一个滴答还剩的计数
+        if (ticks > (0xffff - count) / LATCH + 1)
+            ticks = (0xffff - count) / LATCH + 1;
+        if (ticks > 1 && count > PIT_MARGIN) {
+            idle_count = count + (ticks - 1) * LATCH;
+            idle_ticks = ticks;
+            outb_p(0x30, 0x43);             /* binary, mode 0, LSB/MSB, ch 0 */
+            outb_p(idle_count & 0xff, 0x40);
+            outb(idle_count >> 8, 0x40);
         }
     }
+    __asm__("sti ; hlt");                   ///< sti 之后的一条指令执行完才响应中断，不会漏掉唤醒
+    cli();
+    if (idle_ticks && !hr_armed)            ///< hr 中断照常到来，不用管
+        tick_wakeup();
     sti();
 }
 
@@ -319,6 +781,19 @@ void do_timer(long cpl)
 {
     extern int beepcount;
     extern void sysbeepstop(void);
+    struct timer_list * timer;
+
+    if (hr_armed) {                         ///< 高精度睡眠到期，不是滴答
+        jiffies--;                          ///< 时钟中断已经加过 1 了
+        hr_program(hr_rest);
+        return;
+    }
+    if (idle_ticks)
+        tick_resume();
+    while (timer = hr_list) {               ///< 新的滴答开始，上个滴答里的高精度睡眠者都到期了
+        detach_timer(timer);
+        wake_up_process((struct task_struct *) timer->data);
+    }
 
     if (beepcount)
         if (!--beepcount)
@@ -329,17 +804,7 @@ void do_timer(long cpl)
     else
         current->stime++;
 
-    if (next_timer) {
-        next_timer->jiffies--;
-        while (next_timer && next_timer->jiffies <= 0) {
-            void (*fn)(void);
-            
-            fn = next_timer->fn;
-            next_timer->fn = NULL;
-            next_timer = next_timer->next;
-            (fn)();
-        }
-    }
+    run_timer_list();
     if (current_DOR & 0xf0)
         do_floppy_timer();
     if ((--current->counter)>0) return;
@@ -354,10 +819,97 @@ int sys_alarm(long seconds)
 
     if (old)
         old = (old - jiffies) / HZ;
-    current->alarm = (seconds>0)?(jiffies+HZ*seconds):0;
+    set_alarm((seconds>0)?(jiffies+HZ*seconds):0);
     return (old);
 }
 
+#define NSEC_PER_TICK (1000000000/HZ)
+#define NSEC_PER_COUNT 838                  ///< PIT 一个计数约 838ns
+
+/*
+ * 睡眠 req 指定的时间，被信号打断时返回 -EINTR，rem 不为 NULL 时写回剩余时间。
+ * 到期时刻记成（jiffies，滴答内已经过去的 PIT 计数）：整滴答的部分在时间轮上睡，
+ * 到了最后一个滴答再挂到 hr_list 上，由单次模式的 PIT 在那个时刻叫醒，精确到微秒级。
+ */
+int sys_nanosleep(struct timespec * req, struct timespec * rem)
+{
+    struct task_struct * wait = NULL;
+    struct timer_list hr;
+    unsigned long flags, counts;
+    long sec, nsec, ticks, left;
+
+    sec = get_fs_long((unsigned long *) &req->tv_sec);
+    nsec = get_fs_long((unsigned long *) &req->tv_nsec);
+    if (sec < 0 || nsec < 0 || nsec >= 1000000000)
+        return -EINVAL;
+    if (!sec && !nsec)
+        return 0;
+    if (sec >= 0x7fffffff / HZ - 1)
+        sec = 0x7fffffff / HZ - 2;
+    ticks = sec * HZ + nsec / NSEC_PER_TICK;
+    counts = (((nsec % NSEC_PER_TICK) + 999) / 1000 * 1193 + 999) / 1000;     ///< 不足一个滴答的部分换成计数
+    save_flags(flags);
+    cli();
+    counts += tick_elapsed();
+    ticks += jiffies;
+    restore_flags(flags);
+    while (counts >= LATCH) {
+        counts -= LATCH;
+        ticks++;
+    }
+    hr.next = NULL;
+    hr.pprev = NULL;
+    hr.expires = counts;
+    hr.data = (unsigned long) current;
+    hr.fn = NULL;
+    for (;;) {
+        if ((left = ticks - jiffies) > 0)
+            interruptible_sleep_on_timeout(&wait, left);
+        else {
+            cli();
+            if (left < 0 || tick_elapsed() >= counts) {
+                restore_flags(flags);
+                return 0;
+            }
+            if (hr.next = hr_list)
+                hr_list->pprev = &hr.next;
+            hr_list = &hr;
+            hr.pprev = &hr_list;
+            current->state = TASK_INTERRUPTIBLE;
+            restore_flags(flags);
+            schedule();
+            cli();
+            if (hr.pprev)
+                detach_timer(&hr);
+            restore_flags(flags);
+        }
+        if (current->signal & ~current->blocked)
+            break;
+    }
+    if (rem) {
+        cli();
+        left = ticks - jiffies;
+        nsec = ((long) counts - (long) tick_elapsed()) * NSEC_PER_COUNT;
+        restore_flags(flags);
+        while (nsec < 0) {
+            left--;
+            nsec += NSEC_PER_TICK;
+        }
+        if (left < 0)
+            left = nsec = 0;
+        sec = left / HZ;
+        nsec += (left % HZ) * NSEC_PER_TICK;
+        if (nsec >= 1000000000) {
+            sec++;
+            nsec -= 1000000000;
+        }
+        verify_area(rem, sizeof(*rem));
+        put_fs_long(sec, (unsigned long *) &rem->tv_sec);
+        put_fs_long(nsec, (unsigned long *) &rem->tv_nsec);
+    }
+    return -EINTR;
+}
+
 int sys_getpid(void)
 {
     return current->pid;
@@ -416,7 +968,7 @@ void sched_init(void)
     __asm__("pushfl ; andl $0xffffbfff,(%esp) ; popfl");
     ltr(0);
     lldt(0);
-    outb_p(0x36,0x43);        /* binary, mode 3, LSB/MSB, ch 0 */
+    outb_p(0x34,0x43);        /* binary, mode 2, LSB/MSB, ch 0 */
     outb_p(LATCH & 0xff , 0x40);    /* LSB */
     outb(LATCH >> 8 , 0x40);    /* MSB */
     set_intr_gate(0x20,&timer_interrupt);
@@ -58,13 +58,13 @@ sa_mask = 4
 sa_flags = 8
 sa_restorer = 12
 
-nr_system_calls = 72
+nr_system_calls = 78
 
 /*
  * Ok, I get parallel printer interrupts while using the floppy for some
  * strange reason. Urgel. Now I just ignore them.
  */
-.globl _system_call,_sys_fork,_timer_interrupt,_sys_execve
+.globl _system_call,_sys_fork,_sys_vfork,_timer_interrupt,_sys_execve
 .globl _hd_interrupt,_floppy_interrupt,_parallel_interrupt
 .globl _device_not_available, _coprocessor_error
 
@@ -215,8 +215,25 @@ _sys_fork:
     pushl %edi
     pushl %ebp
     pushl %eax
+    pushl $0                    ; 普通 fork，复制地址空间
     call _copy_process
-    addl $20,%esp
+    addl $24,%esp
+1:    ret
+
+; vfork：子进程借用父进程的地址空间，父进程睡眠到子进程 exec 或 exit
+.align 2
+_sys_vfork:
+    call _find_empty_process
+    testl %eax,%eax
+    js 1f
+    push %gs
+    pushl %esi
+    pushl %edi
+    pushl %ebp
+    pushl %eax
+    pushl $1
+    call _copy_process
+    addl $24,%esp
 1:    ret
 ; 硬盘中断处理程序，中断号0x2E，由(hd.c:369)设置
 _hd_interrupt:
@@ -37,7 +37,7 @@ static inline volatile void oom(void)
 }
 
 #define invalidate() \
-__asm__("movl %%eax,%%cr3"::"a" (0))
+__asm__("movl %%eax,%%cr3"::"a" (current->tss.cr3))
 
 /* these are not to be changed without changing head.s etc */
 #define LOW_MEM 0x100000    /* 内存分页起始于 1MB 处。*/
@@ -51,73 +51,161 @@ current->start_code + current->end_code)
 
 static long HIGH_MEMORY = 0;    ///< 可用内存结尾。
 
+static int shrink_text_pages(void);
+
 #define copy_page(from,to) \
 __asm__("cld ; rep ; movsl"::"S" (from),"D" (to),"c" (1024):"cx","di","si")
 
 static unsigned char mem_map [ PAGING_PAGES ] = {0,};
 
 /*
- * Get physical address of first (actually last :-) free page, and mark it
+ * 空闲页串成单向链表，链接指针存放在空闲页自己的第一个长字中（内核中线性地址就是物理地址）。
+ * mem_map 仍然是每页的引用计数，分配和释放都只操作链表头，与内存大小无关。
+ * 另有一个已经清零的空闲页链表，由 0 号任务空闲时填充，需要清零页的分配从这里取，省掉缺页路径上的清零。
+ */
+static unsigned long free_page_list = 0;   ///< 空闲页链表头（物理地址），0 表示没有空闲页。
+static unsigned long zero_page_list = 0;   ///< 已清零的空闲页链表头，页中只有第一个长字（链接指针）不为 0。
+static long nr_free_pages = 0;             ///< 空闲页个数（包括已清零的）。
+static long nr_zero_pages = 0;             ///< 已清零的空闲页个数。
+
+#define ZERO_POOL_PAGES 64      /* 空闲时最多预先清零这么多页 */
+#define ZERO_BATCH 4            /* 每次空闲最多清零的页数，不让 0 号任务耽误太久 */
+
+#define clear_page(addr) \
+__asm__("cld ; rep ; stosl"::"a" (0),"D" (addr),"c" (1024):"cx","di")
+
+/* 从 *list 链表头取下一页，链表为空时返回 0 */
+static inline unsigned long pop_page(unsigned long * list)
+{
+    unsigned long page;
+
+    if (page = *list)
+        *list = *(unsigned long *) page;
+    return page;
+}
+
+/*
+ * Get physical address of first free page, and mark it
  * used. If no free pages left, return 0.
+ *
+ * GFP_ZERO 时先用已清零的页，没有才当场清零；否则先用未清零的页，把清零的留给需要的人。
  */
+unsigned long __get_free_page(int flags)
+{
+    unsigned long page;
+
+    if (!free_page_list && !zero_page_list)
+        shrink_text_pages();            ///< 内存用完了，先释放一些只被代码页缓存引用的页
+    if (flags & GFP_ZERO)
+    {
+        if (page = pop_page(&zero_page_list))
+            nr_zero_pages--;
+        else if (page = pop_page(&free_page_list))
+            clear_page(page);
+        else
+            return 0;
+    }
+    else if (!(page = pop_page(&free_page_list)))
+    {
+        if (!(page = pop_page(&zero_page_list)))
+            return 0;
+        nr_zero_pages--;
+    }
+    *(unsigned long *) page = 0;        ///< 清掉链接指针
+    if (mem_map[MAP_NR(page)])
+        panic("get_free_page: free page in use");
+    nr_free_pages--;
+    mem_map[MAP_NR(page)] = 1;
+    return page;
+}
+
+/* 获取一个清零的空闲页 */
 unsigned long get_free_page(void)
 {
-register unsigned long __res asm("ax");        ///< 生成代码时，凡是涉及__res变量的操作，都必须通过AX寄存器完成
-
-__asm__("std ; repne ; scasb\n\t"
-    "jne 1f\n\t"
-    "movb $1,1(%%edi)\n\t"
-    "sall $12,%%ecx\n\t"
-    "addl %2,%%ecx\n\t"
-    "movl %%ecx,%%edx\n\t"
-    "movl $1024,%%ecx\n\t"
-    "leal 4092(%%edx),%%edi\n\t"
-    "rep ; stosl\n\t"
-    "movl %%edx,%%eax\n"
-    "1:"
-    :"=a" (__res)                            ///< 输出：EAX → __res
-    :"0" (0),"i" (LOW_MEM),"c" (PAGING_PAGES),    ///< ECX = 页面总数
-    "D" (mem_map+PAGING_PAGES-1)
-    :"di","cx","dx");
-return __res;
+    return __get_free_page(GFP_ZERO);
+}
+
+/**
+ * @brief 0 号任务空闲时调用（见 sys_pause），清零几页空闲页放入已清零链表，直到 ZERO_POOL_PAGES。
+ */
+void refill_zero_pages(void)
+{
+    unsigned long page;
+    int n = ZERO_BATCH;
+
+    while (n-- > 0 && nr_zero_pages < ZERO_POOL_PAGES && (page = pop_page(&free_page_list)))
+    {
+        clear_page(page);
+        *(unsigned long *) page = zero_page_list;
+        zero_page_list = page;
+        nr_zero_pages++;
+    }
 }
 
 /**
- * @brief 释放物理内存页（1页=4096B）
+ * @brief 释放物理内存页（1页=4096B），引用计数减到 0 时放回空闲页链表头。
  */
 void free_page(unsigned long addr)
 {
+    unsigned long nr;
+
     if (addr < LOW_MEM) 
         return;
     if (addr >= HIGH_MEMORY)
         panic("trying to free nonexistent page");
-    addr -= LOW_MEM;
-    addr >>= 12;        ///< 4096B 为 1 页。
-    if (mem_map[addr]--)
+    nr = MAP_NR(addr);      ///< 4096B 为 1 页。
+    if (!mem_map[nr])
+        panic("trying to free free page");
+    if (--mem_map[nr])
         return;
-    mem_map[addr] = 0;
-    panic("trying to free free page");
+    addr &= 0xfffff000;
+    *(unsigned long *) addr = free_page_list;
+    free_page_list = addr;
+    nr_free_pages++;
+}
+
+/*
+ * 给新进程分配页目录：内核部分（TASK_BASE 以下）的目录项从 pg_dir 复制，
+ * 这些目录项开机后不再变化，用户部分为空。内存不够时返回 0。
+ */
+unsigned long new_page_dir(void)
+{
+    unsigned long dir;
+    int i;
+
+    if (!(dir = get_free_page()))
+        return 0;
+    for (i = 0 ; i < (TASK_BASE>>22) ; i++)
+        ((unsigned long *) dir)[i] = pg_dir[i];
+    return dir;
 }
 
 /*
  * This function frees a continuos block of page tables, as needed
  * by 'exit()'. As does copy_page_tables(), this handles only 4Mb blocks.
+ * 页表属于页目录 pgd（某个进程的 tss.cr3），页目录本身不释放。
  */
-int free_page_tables(unsigned long from,unsigned long size)
+int free_page_tables(unsigned long pgd,unsigned long from,unsigned long size)
 {
     unsigned long *pg_table;
     unsigned long * dir, nr;
 
     if (from & 0x3fffff)
         panic("free_page_tables called with wrong alignment");
-    if (!from)
+    if (from < TASK_BASE)
         panic("Trying to free up swapper memory space");
     size = (size + 0x3fffff) >> 22;
-    dir = (unsigned long *) ((from>>20) & 0xffc); /* _pg_dir = 0 */
+    dir = PDE(pgd,from);
     for ( ; size-->0 ; dir++) {
         if (!(1 & *dir))
             continue;
         pg_table = (unsigned long *) (0xfffff000 & *dir);
+        if (mem_map[MAP_NR((unsigned long) pg_table)] > 1) {
+            /* 页表还和别的进程共享着，只去掉自己的引用 */
+            free_page((unsigned long) pg_table);
+            *dir = 0;
+            continue;
+        }
         for (nr=0 ; nr<1024 ; nr++) {
             if (1 & *pg_table)
                 free_page(0xfffff000 & *pg_table);
@@ -147,8 +235,16 @@ int free_page_tables(unsigned long from,unsigned long size)
  * doesn't take any more memory - we don't copy-on-write in the low
  * 1 Mb-range, so the pages can be shared with the kernel. Thus the
  * special case for nr=xxxx.
+ *
+ * 除此之外页表本身也是写时复制的：子进程的页目录项直接指向父进程的页表，
+ * 页表的 mem_map 加一，父子双方的页目录项都去掉写权限。页表中的页仍然只算一次引用，
+ * 直到某一方第一次写（或者要修改页表）时由 unshare_page_table 复制页表。
+ * 这样 fork 之后马上 exec 就不用复制任何页表项了。
+ *
+ * 线性地址 from 属于页目录 from_pgd（父进程），to 属于页目录 to_pgd（子进程）。
  */
-int copy_page_tables(unsigned long from,unsigned long to,long size)
+int copy_page_tables(unsigned long from_pgd,unsigned long to_pgd,
+    unsigned long from,unsigned long to,long size)
 {
     unsigned long * from_page_table;
     unsigned long * to_page_table;
@@ -158,8 +254,8 @@ int copy_page_tables(unsigned long from,unsigned long to,long size)
 
     if ((from&0x3fffff) || (to&0x3fffff))
         panic("copy_page_tables called with wrong alignment");
-    from_dir = (unsigned long *) ((from>>20) & 0xffc); /* _pg_dir = 0 */
-    to_dir = (unsigned long *) ((to>>20) & 0xffc);
+    from_dir = PDE(from_pgd,from);
+    to_dir = PDE(to_pgd,to);
     size = ((unsigned) (size+0x3fffff)) >> 22;
     for( ; size-->0 ; from_dir++,to_dir++) {
         if (1 & *to_dir)
@@ -167,6 +263,12 @@ int copy_page_tables(unsigned long from,unsigned long to,long size)
         if (!(1 & *from_dir))
             continue;
         from_page_table = (unsigned long *) (0xfffff000 & *from_dir);
+        if (from) {
+            *from_dir &= ~2;
+            *to_dir = *from_dir;
+            mem_map[MAP_NR((unsigned long) from_page_table)]++;
+            continue;
+        }
         if (!(to_page_table = (unsigned long *) get_free_page()))
             return -1;    /* Out of memory, see freeing */
         *to_dir = ((unsigned long) to_page_table) | 7;
@@ -195,30 +297,252 @@ int copy_page_tables(unsigned long from,unsigned long to,long size)
  * out of memory (either when trying to access page-table or
  * page.)
  */
-unsigned long put_page(unsigned long page,unsigned long address)
+/*
+ * 页目录项 dir 没有写权限，说明它指向的页表是 fork 时共享的（见 copy_page_tables）。
+ * 页表只剩自己在用时恢复写权限就行；否则复制一份页表，其中的页都写保护并且增加引用，
+ * 以后就是普通的页写时复制了。内存不够时返回 0。
+ */
+static int unshare_page_table(unsigned long * dir)
 {
-    unsigned long tmp, *page_table;
+    unsigned long old_table, new_table, page;
+    unsigned long * from, * to;
+    int nr;
 
-/* NOTE !!! This uses the fact that _pg_dir=0 */
+    old_table = 0xfffff000 & *dir;
+    if (mem_map[MAP_NR(old_table)] == 1) {
+        *dir |= 2;
+        invalidate();
+        return 1;
+    }
+    if (!(new_table = __get_free_page(0)))     /* 1024 项全部复制 */
+        return 0;
+    from = (unsigned long *) old_table;
+    to = (unsigned long *) new_table;
+    for (nr = 1024 ; nr-- > 0 ; from++,to++) {
+        page = *from;
+        if (1 & page) {
+            page &= ~2;
+            *from = page;
+            if (page >= LOW_MEM)
+                mem_map[MAP_NR(page)]++;
+        }
+        *to = page;
+    }
+    mem_map[MAP_NR(old_table)]--;
+    *dir = new_table | 7;
+    invalidate();
+    return 1;
+}
 
-    if (page < LOW_MEM || page >= HIGH_MEMORY)
-        printk("Trying to put page %p at %p\n",page,address);
-    if (mem_map[(page-LOW_MEM)>>12] != 1)
-        printk("mem_map disagrees with %p at %p\n",page,address);
-    page_table = (unsigned long *) ((address>>20) & 0xffc);
-    if ((*page_table)&1)
+/*
+ * 把物理页 page 映射到线性地址 address，prot 为页表项的低位（7 可写，5 只读）。
+ * 需要时分配页表，页表和别的进程共享时先复制一份。
+ */
+unsigned long map_page(unsigned long page,unsigned long address,int prot)
+{
+    unsigned long tmp, *page_table;
+
+    page_table = PDE(current->tss.cr3,address);
+    if ((*page_table)&1) {
+        if (!(*page_table & 2) && !unshare_page_table(page_table))
+            return 0;
         page_table = (unsigned long *) (0xfffff000 & *page_table);
-    else {
+    } else {
         if (!(tmp=get_free_page()))
             return 0;
         *page_table = tmp|7;
         page_table = (unsigned long *) tmp;
     }
-    page_table[(address>>12) & 0x3ff] = page | 7;
+    page_table[(address>>12) & 0x3ff] = page | prot;
 /* no need for invalidate */
     return page;
 }
 
+/*
+ * 释放线性地址 [from, from+size) 中已经映射的页并清除页表项，用于 munmap。
+ * 页表不释放；和别的进程共享的页表先复制一份再改。
+ */
+void unmap_page_range(unsigned long from,unsigned long size)
+{
+    unsigned long * dir, * pg_table;
+
+    for ( ; size >= 4096 ; size -= 4096, from += 4096) {
+        dir = PDE(current->tss.cr3,from);
+        if (!(1 & *dir))
+            continue;
+        if (!(2 & *dir) && !unshare_page_table(dir))
+            oom();
+        pg_table = (unsigned long *) (0xfffff000 & *dir) + ((from>>12) & 0x3ff);
+        if (1 & *pg_table) {
+            free_page(0xfffff000 & *pg_table);
+            *pg_table = 0;
+        }
+    }
+    invalidate();
+}
+
+unsigned long put_page(unsigned long page,unsigned long address)
+{
+    if (page < LOW_MEM || page >= HIGH_MEMORY)
+        printk("Trying to put page %p at %p\n",page,address);
+    if (mem_map[(page-LOW_MEM)>>12] != 1)
+        printk("mem_map disagrees with %p at %p\n",page,address);
+    return map_page(page,address,7);
+}
+
+/*
+ * 可执行文件代码页缓存：按 (设备, inode 号, 页号) 记住缺页时读入的代码页，进程退出后仍然保留，
+ * 以后再运行同一个程序时直接只读映射，不再经过缓冲区读盘和复制。缓存占有页面的一个引用，
+ * 所以进程写这样的页时 un_wp_page 会复制一份，缓存中的页不会被改动。
+ * 文件被写或者截断、设备卸下时丢掉对应的页；内存不够时释放只有缓存在引用的页。
+ */
+#define NR_TEXT_PAGES 256
+#define NR_TEXT_HASH 61
+
+struct text_page
+{
+    unsigned short t_dev;               ///< 设备号，0 表示空闲。
+    unsigned short t_ino;               ///< 可执行文件的 inode 号。
+    unsigned long t_index;              ///< 文件中代码的第几页。
+    unsigned long t_page;               ///< 缓存的物理页。
+    struct text_page * t_next;          ///< 哈希链，只按设备和 inode 号散列，方便丢掉一个文件的全部页。
+    struct text_page * t_lru_next;      ///< 环形 LRU 链表，表头最先被复用。
+    struct text_page * t_lru_prev;
+};
+
+static struct text_page text_pages[NR_TEXT_PAGES];
+static struct text_page * text_hash[NR_TEXT_HASH];
+static struct text_page * text_lru = NULL;
+
+#define text_hashfn(dev,ino) (((unsigned)((dev)^(ino)))%NR_TEXT_HASH)
+
+/**
+ * @brief 把 t 移到 LRU 链表表尾（最近使用），first 非 0 时移到表头（最先复用）。
+ */
+static void text_touch(struct text_page * t, int first)
+{
+    int i;
+
+    if (!text_lru)      ///< 第一次使用时串起所有项
+    {
+        for (i = 0; i < NR_TEXT_PAGES; i++)
+        {
+            text_pages[i].t_lru_next = text_pages + (i + 1) % NR_TEXT_PAGES;
+            text_pages[i].t_lru_prev = text_pages + (i + NR_TEXT_PAGES - 1) % NR_TEXT_PAGES;
+        }
+        text_lru = text_pages;
+    }
+    if (text_lru == t)
+        text_lru = t->t_lru_next;
+    t->t_lru_prev->t_lru_next = t->t_lru_next;
+    t->t_lru_next->t_lru_prev = t->t_lru_prev;
+    t->t_lru_next = text_lru;
+    t->t_lru_prev = text_lru->t_lru_prev;
+    text_lru->t_lru_prev->t_lru_next = t;
+    text_lru->t_lru_prev = t;
+    if (first)
+        text_lru = t;
+}
+
+/* 丢掉一个缓存项，释放缓存对页面的引用 */
+static void text_drop(struct text_page * t)
+{
+    struct text_page ** p;
+
+    for (p = text_hash + text_hashfn(t->t_dev, t->t_ino); *p; p = &(*p)->t_next)
+        if (*p == t)
+        {
+            *p = t->t_next;
+            break;
+        }
+    free_page(t->t_page);
+    t->t_dev = 0;
+    t->t_next = NULL;
+    text_touch(t, 1);
+}
+
+static struct text_page * find_text_page(int dev, int ino, unsigned long index)
+{
+    struct text_page * t;
+
+    for (t = text_hash[text_hashfn(dev, ino)]; t; t = t->t_next)
+        if (t->t_dev == dev && t->t_ino == ino && t->t_index == index)
+            return t;
+    return NULL;
+}
+
+/**
+ * @brief 把刚读入的代码页 page 加入缓存，缓存增加一个引用。复用 LRU 表头的项。
+ */
+static void add_text_page(int dev, int ino, unsigned long index, unsigned long page)
+{
+    struct text_page * t;
+    int h;
+
+    if (find_text_page(dev, ino, index))    ///< 读盘睡眠期间别的进程已经加入了
+        return;
+    if (!text_lru)
+        text_touch(text_pages, 0);
+    t = text_lru;
+    if (t->t_dev)
+        text_drop(t);
+    t->t_dev = dev;
+    t->t_ino = ino;
+    t->t_index = index;
+    t->t_page = page;
+    mem_map[MAP_NR(page)]++;
+    h = text_hashfn(dev, ino);
+    t->t_next = text_hash[h];
+    text_hash[h] = t;
+    text_touch(t, 0);
+}
+
+/**
+ * @brief 丢掉设备 dev 上 inode 号 ino 的缓存代码页，ino 为 0 时丢掉整个设备的。
+ * @details 文件被写或截断时由 file_write、truncate 调用，设备卸下或换盘时由 sys_umount、check_disk_change 调用。
+ */
+void invalidate_text_pages(int dev, int ino)
+{
+    struct text_page * t, * next;
+
+    if (!ino)
+    {
+        for (t = text_pages; t < text_pages + NR_TEXT_PAGES; t++)
+            if (t->t_dev == dev)
+                text_drop(t);
+        return;
+    }
+    for (t = text_hash[text_hashfn(dev, ino)]; t; t = next)
+    {
+        next = t->t_next;
+        if (t->t_dev == dev && t->t_ino == ino)
+            text_drop(t);
+    }
+}
+
+/**
+ * @brief 内存用完时，从 LRU 表头开始释放只被缓存引用（mem_map 为 1）的代码页，最多 8 页。
+ * @return 释放的页数。
+ */
+static int shrink_text_pages(void)
+{
+    struct text_page * t, * next;
+    int i, freed = 0;
+
+    if (!(t = text_lru))
+        return 0;
+    for (i = 0; i < NR_TEXT_PAGES && freed < 8; i++, t = next)
+    {
+        next = t->t_lru_next;
+        if (t->t_dev && mem_map[MAP_NR(t->t_page)] == 1)
+        {
+            text_drop(t);
+            freed++;
+        }
+    }
+    return freed;
+}
+
 void un_wp_page(unsigned long * table_entry)
 {
     unsigned long old_page,new_page;
@@ -229,7 +553,7 @@ void un_wp_page(unsigned long * table_entry)
         invalidate();
         return;
     }
-    if (!(new_page=get_free_page()))
+    if (!(new_page=__get_free_page(0)))    /* copy_page 会覆盖整页 */
         oom();
     if (old_page >= LOW_MEM)
         mem_map[MAP_NR(old_page)]--;
@@ -253,22 +577,35 @@ void do_wp_page(unsigned long error_code,unsigned long address)
     if (CODE_SPACE(address))
         do_exit(SIGSEGV);
 #endif
+    unsigned long * dir = PDE(current->tss.cr3,address);
+
+    if (mmap_write_denied(address))     /* 只读的文件映射，不能当作写时复制放行 */
+        do_exit(SIGSEGV);
+    if (!(2 & *dir) && !unshare_page_table(dir))
+        oom();
     un_wp_page((unsigned long *)
-        (((address>>10) & 0xffc) + (0xfffff000 &
-        *((unsigned long *) ((address>>20) &0xffc)))));
+        (((address>>10) & 0xffc) + (0xfffff000 & *dir)));
 
 }
 
 void write_verify(unsigned long address)
 {
     unsigned long page;
+    unsigned long * dir = PDE(current->tss.cr3,address);
 
-    if (!( (page = *((unsigned long *) ((address>>20) & 0xffc)) )&1))
+    if (!(*dir & 1))
         return;
-    page &= 0xfffff000;
+    if (!(*dir & 2) && !unshare_page_table(dir))    /* 共享的页表，先复制一份 */
+        oom();
+    page = *dir & 0xfffff000;
     page += ((address>>10) & 0xffc);
-    if ((3 & *(unsigned long *) page) == 1)  /* non-writeable, present */
+    if ((3 & *(unsigned long *) page) == 1) {    /* non-writeable, present */
+        if (mmap_write_denied(address)) {   /* 内核要替进程写只读映射，系统调用返回时收到 SIGSEGV */
+            current->signal |= (1<<(SIGSEGV-1));
+            return;
+        }
         un_wp_page((unsigned long *) page);
+    }
     return;
 }
 
@@ -298,9 +635,8 @@ static int try_to_share(unsigned long address, struct task_struct * p)
     unsigned long to_page;
     unsigned long phys_addr;
 
-    from_page = to_page = ((address>>20) & 0xffc);
-    from_page += ((p->start_code>>20) & 0xffc);
-    to_page += ((current->start_code>>20) & 0xffc);
+    from_page = (unsigned long) PDE(p->tss.cr3,p->start_code+address);
+    to_page = (unsigned long) PDE(current->tss.cr3,current->start_code+address);
 /* is there a page-directory at from? */
     from = *(unsigned long *) from_page;
     if (!(from & 1))
@@ -320,6 +656,11 @@ static int try_to_share(unsigned long address, struct task_struct * p)
             *(unsigned long *) to_page = to | 7;
         else
             oom();
+    else if (!(to & 2)) {           /* 自己的页表还和别人共享着 */
+        if (!unshare_page_table((unsigned long *) to_page))
+            oom();
+        to = *(unsigned long *) to_page;
+    }
     to &= 0xfffff000;
     to_page = to + ((address>>10) & 0xffc);
     if (1 & *(unsigned long *) to_page)
@@ -368,17 +709,33 @@ void do_no_page(unsigned long error_code,unsigned long address)
     int nr[4];
     unsigned long tmp;
     unsigned long page;
-    int block,i;
+    struct text_page * t;
+    int block,i,text;
 
     address &= 0xfffff000;
+    if (i = mmap_no_page(address)) {       /* 文件映射 */
+        if (i < 0)
+            oom();
+        return;
+    }
     tmp = address - current->start_code;
     if (!current->executable || tmp >= current->end_data) {
         get_empty_page(address);
         return;
     }
+    text = tmp + 4096 <= current->end_code;    /* 整页都是代码，可以进代码页缓存 */
+    if (text && (t = find_text_page(current->executable->i_dev,
+        current->executable->i_num, tmp >> 12))) {
+        text_touch(t, 0);
+        mem_map[MAP_NR(t->t_page)]++;
+        if (map_page(t->t_page,address,5))     /* 只读映射，写时复制 */
+            return;
+        free_page(t->t_page);
+        oom();
+    }
     if (share_page(tmp))
         return;
-    if (!(page = get_free_page()))
+    if (!(page = __get_free_page(0)))     /* bread_page 填满整页（空洞填 0） */
         oom();
 /* remember that 1 block is used for header */
     block = 1 + tmp/BLOCK_SIZE;
@@ -391,6 +748,15 @@ void do_no_page(unsigned long error_code,unsigned long address)
         tmp--;
         *(char *)tmp = 0;
     }
+    if (text) {
+        if (!map_page(page,address,5)) {
+            free_page(page);
+            oom();
+        }
+        add_text_page(current->executable->i_dev,
+            current->executable->i_num, (address - current->start_code) >> 12, page);
+        return;
+    }
     if (put_page(page,address))
         return;
     free_page(page);
@@ -402,26 +768,37 @@ void mem_init(long start_mem, long end_mem) /* end_mem 可用内存结尾 */
     int i;
 
     HIGH_MEMORY = end_mem;
+    start_mem = (start_mem + 4095) & ~4095;    ///< 空闲链表要写入整页，起点按页对齐
     for (i=0 ; i<PAGING_PAGES ; i++)
         mem_map[i] = USED;
     i = MAP_NR(start_mem);
     end_mem -= start_mem;
     end_mem >>= 12;
-    while (end_mem-->0)
-        mem_map[i++]=0;
+    while (end_mem-->0)     ///< 从低到高逐页放入空闲链表，最高的页最先被分配，与原来从后往前扫描一致。
+    {
+        mem_map[i] = 0;
+        *(unsigned long *) start_mem = free_page_list;
+        free_page_list = start_mem;
+        nr_free_pages++;
+        start_mem += 4096;
+        i++;
+    }
 }
 
 void calc_mem(void)
 {
     int i,j,k,free=0;
     long * pg_tbl;
+    unsigned long * dir = (unsigned long *) current->tss.cr3;
 
     for(i=0 ; i<PAGING_PAGES ; i++)
         if (!mem_map[i]) free++;
+    if (free != nr_free_pages)
+        printk("free page list has %d pages\n\r",nr_free_pages);
     printk("%d pages free (of %d)\n\r",free,PAGING_PAGES);
     for(i=2 ; i<1024 ; i++) {
-        if (1&pg_dir[i]) {
-            pg_tbl=(long *) (0xfffff000 & pg_dir[i]);
+        if (1&dir[i]) {
+            pg_tbl=(long *) (0xfffff000 & dir[i]);
             for(j=k=0 ; j<1024 ; j++)
                 if (pg_tbl[j]&1)
                     k++;
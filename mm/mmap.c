@@ -0,0 +1,214 @@
+/*
+ *  linux/mm/mmap.c
+ *
+ * 文件映射（mmap/munmap）：只支持只读的共享映射和私有映射。
+ * 每个进程最多 NR_MMAP 个映射描述符（task_struct 中的 mmap[]），
+ * 页面在缺页时由 mmap_no_page 从文件读入，不再经过 read() 的逐字节复制。
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <linux/sched.h>
+#include <linux/kernel.h>
+#include <asm/segment.h>
+
+/**
+ * @brief 在 [MMAP_BASE, 栈底) 之间为 len 字节的映射找一个空位，从 brk 之上开始找。
+ * @return 段内偏移地址，0 表示没有空位。
+ */
+static unsigned long get_unmapped_area(unsigned long len)
+{
+    unsigned long addr, limit;
+    struct vm_area * vma;
+    int i;
+
+    addr = (current->brk + 4095) & 0xfffff000;
+    if (addr < MMAP_BASE)
+        addr = MMAP_BASE;
+    limit = (current->start_stack & 0xfffff000) - 16384;
+repeat:
+    if (addr + len > limit || addr + len < addr)
+        return 0;
+    for (i = 0, vma = current->mmap; i < NR_MMAP; i++, vma++)
+        if (vma->vm_inode && addr < vma->vm_end && addr + len > vma->vm_start)
+        {
+            addr = vma->vm_end;
+            goto repeat;
+        }
+    return addr;
+}
+
+/**
+ * @brief 映射文件，参数放在用户空间的 buffer 中：{ addr, len, prot, flags, fd, offset }。
+ * @details addr 只是建议，总是由内核选择地址。可写的映射只能是 MAP_PRIVATE，写入的内容不会回到文件。
+ * 没有 PROT_WRITE 的映射是真正只读的：进程写它会收到 SIGSEGV。
+ * @return 映射的起始地址（段内偏移），出错时为负的错误码。
+ */
+int sys_mmap(unsigned long * buffer)
+{
+    unsigned long len, prot, flags, fd, off, addr;
+    struct m_inode * inode;
+    struct vm_area * vma;
+    struct file * file;
+    int i;
+
+    len = get_fs_long(buffer + 1);
+    prot = get_fs_long(buffer + 2);
+    flags = get_fs_long(buffer + 3);
+    fd = get_fs_long(buffer + 4);
+    off = get_fs_long(buffer + 5);
+    if (fd >= NR_OPEN || !(file = current->filp[fd]) || !(inode = file->f_inode))
+        return -EBADF;
+    if (!S_ISREG(inode->i_mode))
+        return -ENODEV;
+    if ((file->f_flags & O_ACCMODE) == O_WRONLY)
+        return -EACCES;
+    if (!len || (off & 0xfff))
+        return -EINVAL;
+    switch (flags & MAP_TYPE)
+    {
+        case MAP_SHARED:
+            if (prot & PROT_WRITE)      ///< 共享映射的修改要写回文件，不支持
+                return -EINVAL;
+            break;
+        case MAP_PRIVATE:
+            break;
+        default:
+            return -EINVAL;
+    }
+    for (i = 0, vma = current->mmap; i < NR_MMAP; i++, vma++)
+        if (!vma->vm_inode)
+            break;
+    if (i >= NR_MMAP)
+        return -ENOMEM;
+    len = (len + 4095) & 0xfffff000;
+    if (!(addr = get_unmapped_area(len)))
+        return -ENOMEM;
+    vma->vm_start = addr;
+    vma->vm_end = addr + len;
+    vma->vm_offset = off;
+    vma->vm_prot = prot;
+    vma->vm_inode = inode;
+    inode->i_count++;
+    return addr;
+}
+
+/* 释放映射占用的页面，归还 inode */
+static void unmap_area(struct vm_area * vma)
+{
+    unmap_page_range(current->start_code + vma->vm_start, vma->vm_end - vma->vm_start);
+    iput(vma->vm_inode);
+    vma->vm_inode = NULL;
+}
+
+/**
+ * @brief 解除 [addr, addr+len) 中的映射，只能整个解除，部分覆盖一个映射时返回 -EINVAL。
+ */
+int sys_munmap(unsigned long addr, unsigned long len)
+{
+    struct vm_area * vma;
+    unsigned long end;
+    int i;
+
+    if ((addr & 0xfff) || !len)
+        return -EINVAL;
+    end = addr + ((len + 4095) & 0xfffff000);
+    for (i = 0, vma = current->mmap; i < NR_MMAP; i++, vma++)
+        if (vma->vm_inode && addr < vma->vm_end && end > vma->vm_start &&
+            (addr > vma->vm_start || end < vma->vm_end))
+            return -EINVAL;
+    for (i = 0, vma = current->mmap; i < NR_MMAP; i++, vma++)
+        if (vma->vm_inode && addr <= vma->vm_start && end >= vma->vm_end)
+            unmap_area(vma);
+    return 0;
+}
+
+/**
+ * @brief exec 和 exit 时丢掉进程的全部映射描述符。页面由随后的 free_page_tables 释放。
+ */
+void exit_mmap(void)
+{
+    struct vm_area * vma;
+    int i;
+
+    for (i = 0, vma = current->mmap; i < NR_MMAP; i++, vma++)
+        if (vma->vm_inode)
+        {
+            iput(vma->vm_inode);
+            vma->vm_inode = NULL;
+        }
+}
+
+/**
+ * @brief 判断 new_brk 是否会和映射重叠，由 sys_brk 调用。
+ */
+int mmap_overlap(unsigned long start, unsigned long end)
+{
+    struct vm_area * vma;
+    int i;
+
+    for (i = 0, vma = current->mmap; i < NR_MMAP; i++, vma++)
+        if (vma->vm_inode && start < vma->vm_end && end > vma->vm_start)
+            return 1;
+    return 0;
+}
+
+/**
+ * @brief 线性地址 address 落在某个没有 PROT_WRITE 的映射中时返回 1，由 do_wp_page/write_verify 调用。
+ */
+int mmap_write_denied(unsigned long address)
+{
+    struct vm_area * vma;
+    int i;
+
+    address -= current->start_code;
+    for (i = 0, vma = current->mmap; i < NR_MMAP; i++, vma++)
+        if (vma->vm_inode && address >= vma->vm_start && address < vma->vm_end)
+            return !(vma->vm_prot & PROT_WRITE);
+    return 0;
+}
+
+/**
+ * @brief do_no_page 的一部分：缺页地址落在某个映射中时，从文件读入这一页。
+ * @details 和可执行文件一样用 bmap + bread_page 读入 4 个块，文件结尾之后的部分清零。
+ * 没有 PROT_WRITE 时只读映射。
+ * @retval 0 不在任何映射中
+ * @retval 1 已经映射好
+ * @retval -1 内存不够
+ */
+int mmap_no_page(unsigned long address)
+{
+    struct vm_area * vma;
+    struct m_inode * inode;
+    unsigned long tmp, pos, page;
+    int nr[4], i;
+
+    tmp = address - current->start_code;
+    for (i = 0, vma = current->mmap; i < NR_MMAP; i++, vma++)
+        if (vma->vm_inode && tmp >= vma->vm_start && tmp < vma->vm_end)
+            break;
+    if (i >= NR_MMAP)
+        return 0;
+    if (!(page = __get_free_page(0)))   ///< bread_page 填满整页
+        return -1;
+    inode = vma->vm_inode;
+    pos = tmp - vma->vm_start + vma->vm_offset;
+    for (i = 0; i < 4; i++)
+        nr[i] = (pos + i * BLOCK_SIZE < inode->i_size) ? bmap(inode, pos / BLOCK_SIZE + i) : 0;
+    bread_page(page, inode->i_dev, nr);
+    if (pos + 4096 > inode->i_size)
+    {
+        i = (inode->i_size > pos) ? inode->i_size - pos : 0;
+        memset((char *) page + i, 0, 4096 - i);
+    }
+    if (!map_page(page, address, (vma->vm_prot & PROT_WRITE) ? 7 : 5))
+    {
+        free_page(page);
+        return -1;
+    }
+    return 1;
+}